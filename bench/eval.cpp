@@ -0,0 +1,110 @@
+// time per evaluation of a few formulas with every evaluator, and how many
+// times faster than the tree walker with a map each one is.
+//
+//   bench-eval [--runs N] [formula...]
+//
+// x, y and z are 1.5, -2 and 3, anything else has to be assigned before it's read.
+
+#include "Expression.h"
+#include "FlatExpression.h"
+#include "Bytecode.h"
+#include "Program.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// keeps the compiler from dropping results nobody reads
+static volatile double sink;
+
+// ns per call of `evaluate`, best of three rounds of `runs` calls
+template <class F>
+static double time(long runs, F evaluate) {
+    double best = 1e300;
+
+    for (int round = 0; round < 3; round++) {
+        auto start = std::chrono::steady_clock::now();
+        double sum = 0;
+
+        for (long i = 0; i < runs; i++) sum += evaluate();
+
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / runs);
+        sink = sum;
+    }
+
+    return best;
+}
+
+int main(int argc, char **argv) {
+    long runs = 2000000;
+    std::vector<std::string> formulas;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) runs = std::stol(argv[++i]);
+        else formulas.push_back(argv[i]);
+    }
+
+    if (formulas.empty()) {
+        formulas = {
+            "x*x + y*y - 2*x*y / (z + 1)",
+            "(x + 1) ** 2 * 3600 + y/7 - z*0.5",
+            "((1 + 2) * 3 - 4 / 5 + 6 * 7 - 8 + 9 * 10 - 11 / 12 + 13 * 14 - 15 + 16) * 17",
+            "(w = x * y) + w * z - (w = w / 2) * w",
+        };
+    }
+
+    const char *names[] = { "x", "y", "z" };
+    const double values[] = { 1.5, -2.0, 3.0 };
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "ns/eval\ttree/map\ttree/slot\tflat/map\tstack vm\tregister vm\n";
+
+    for (auto& formula : formulas) {
+        std::vector<Lexicon> lexes = Lexicon::lex(formula);
+        Arena arena;
+        Expression *expr = Expression::parse(lexes, arena);
+
+        Bindings bindings;
+        expr->bind(bindings);
+
+        FlatExpression flat(*expr);
+        Bytecode bytecode(flat, bindings);
+        Program program(*expr, bindings);
+
+        std::unordered_map<Symbol, double> named;
+        Environment environment(bindings);
+        std::vector<double> scratch;
+        Bytecode::Frame stack;
+        Program::Frame registers;
+
+        for (int i = 0; i < 3; i++) {
+            Symbol symbol = SymbolTable::intern(names[i]);
+            named[symbol] = values[i];
+
+            if (bindings.slot(symbol) != Bindings::NOSLOT)
+                environment.set(bindings.slot(symbol), values[i]);
+        }
+
+        // the formulas only assign variables before reading them, so every run gives the same result
+        double times[] = {
+            time(runs, [&] { return expr->evaluate(named); }),
+            time(runs, [&] { return expr->evaluate(environment); }),
+            time(runs, [&] { return flat.evaluate(named, scratch); }),
+            time(runs, [&] { return bytecode.run(environment, stack); }),
+            time(runs, [&] { return program.run(environment, registers); }),
+        };
+
+        std::cout << formula << "\n";
+
+        for (double t : times)
+            std::cout << "\t" << t << " (" << times[0] / t << "x)";
+
+        std::cout << "\n";
+    }
+
+    return 0;
+}
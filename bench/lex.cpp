@@ -0,0 +1,141 @@
+// lexer throughput in bytes per cycle, for every scanner the cpu can run.
+//
+//   bench-lex [--size MiB] [file...]
+//
+// each file, and a generated soup of random tokens, is repeated up to the
+// given size and lexed three times, the best run counts. on x86 cycles are
+// rdtsc ticks, elsewhere the figure is bytes per nanosecond.
+//
+// only Lexicon::lex is needed, so the same file measures older trees too, e.g.
+// the lexer from before the DFA:
+//   git worktree add /tmp/old 768c2e9
+//   g++ -O3 -std=c++17 -I/tmp/old/src bench/lex.cpp $(ls /tmp/old/src/*.cpp | grep -v main.cpp)
+
+#include "Lexicon.h"
+
+#if __has_include("Scan.h")
+#include "Scan.h"
+#define QUASI_BENCH_SCANNERS
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define QUASI_BENCH_RDTSC
+#endif
+
+static uint64_t now() {
+#ifdef QUASI_BENCH_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static std::string repeat(const std::string& text, size_t size) {
+    std::string out;
+    out.reserve(size + text.size());
+
+    while (out.size() < size) out += text;
+
+    return out;
+}
+
+// valid tokens of every kind in random order, so few runs are long enough to skip
+static std::string soup(size_t size) {
+    static const char *tokens[] = {
+        "fn", "let", "return", "i32", "f64", "x", "value", "a1", "longerName", "12", "3.25", "0",
+        "+", "-", "*", "**", "/", "=", "==", "!=", "<", "<=", "(", ")", "{", "}", ":", ",", ";",
+    };
+
+    std::mt19937 rng(20261016);
+    std::string out;
+
+    while (out.size() < size) {
+        out += tokens[rng() % (sizeof(tokens) / sizeof(*tokens))];
+        out += rng() % 8 == 0 ? '\n' : ' ';
+    }
+
+    return out;
+}
+
+static double bytes_per_cycle(const std::string& input) {
+    double best = 0;
+
+    for (int run = 0; run < 3; run++) {
+        uint64_t start = now();
+        std::vector<Lexicon> lexes = Lexicon::lex(input);
+        uint64_t cycles = now() - start;
+
+        best = std::max(best, static_cast<double>(input.size()) / cycles);
+    }
+
+    return best;
+}
+
+int main(int argc, char **argv) {
+    size_t size = 64 << 20;
+    std::vector<std::pair<std::string, std::string>> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = std::stoul(argv[++i]) << 20;
+            continue;
+        }
+
+        std::ifstream file(argv[i], std::ios::binary);
+
+        if (!file) {
+            std::cerr << "can't read " << argv[i] << "\n";
+            return 1;
+        }
+
+        std::stringstream text;
+        text << file.rdbuf();
+        inputs.emplace_back(argv[i], repeat(text.str(), size));
+    }
+
+    inputs.emplace_back("token soup", soup(size));
+
+#ifdef QUASI_BENCH_SCANNERS
+    const char *scanners[] = { "none", "scalar", "sse2", "avx2" };
+#else
+    const char *scanners[] = { "built in" };
+#endif
+
+#ifdef QUASI_BENCH_RDTSC
+    std::cout << "bytes/cycle";
+#else
+    std::cout << "bytes/ns";
+#endif
+
+    for (auto scanner : scanners) std::cout << "\t" << scanner;
+    std::cout << "\n";
+
+    for (auto& [name, input] : inputs) {
+        std::cout << name;
+
+        for (auto scanner : scanners) {
+#ifdef QUASI_BENCH_SCANNERS
+            if (!Scanner::select(scanner)) {
+                std::cout << "\t-";
+                continue;
+            }
+#endif
+            std::cout << "\t" << bytes_per_cycle(input) << std::flush;
+        }
+
+        std::cout << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "Arena.h"
+
+#include <algorithm>
+
+// blocks double in size up to this, so big parses don't need a block per few nodes
+static constexpr size_t max_block_size = 1 << 20;
+
+//=============================================================================
+// Constructors and Destructors
+//=============================================================================
+
+Arena::Arena(size_t block_size) : m_block_size(block_size) {}
+
+Arena::Arena(Arena&& other)
+    : m_blocks(std::move(other.m_blocks)), m_next(other.m_next), m_end(other.m_end),
+      m_block_size(other.m_block_size), m_reserved(other.m_reserved) {
+    other.m_blocks.clear();
+    other.m_next = other.m_end = nullptr;
+    other.m_reserved = 0;
+}
+
+Arena& Arena::operator=(Arena&& other) {
+    if (this != &other) {
+        m_blocks = std::move(other.m_blocks);
+        m_next = other.m_next;
+        m_end = other.m_end;
+        m_block_size = other.m_block_size;
+        m_reserved = other.m_reserved;
+
+        other.m_blocks.clear();
+        other.m_next = other.m_end = nullptr;
+        other.m_reserved = 0;
+    }
+
+    return *this;
+}
+
+//=============================================================================
+// Public Functions
+//=============================================================================
+
+size_t Arena::reserved() const {
+    return m_reserved;
+}
+
+void *Arena::grow(size_t size, size_t align) {
+    size_t block = std::max(m_block_size, size + align);
+
+    // not make_unique, which would zero the whole block
+    m_blocks.emplace_back(new std::byte[block]);
+    m_reserved += block;
+    m_next = m_blocks.back().get();
+    m_end = m_next + block;
+
+    if (block == m_block_size)
+        m_block_size = std::min(m_block_size * 2, max_block_size);
+
+    return allocate(size, align);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// bump allocator, memory is only given back all at once when the arena is destroyed.
+// nothing allocated from it is ever destructed, so it only holds trivially destructible types
+class Arena {
+    std::vector<std::unique_ptr<std::byte[]>> m_blocks;
+    std::byte *m_next = nullptr, *m_end = nullptr;
+    size_t m_block_size;
+    size_t m_reserved = 0;
+
+    void *grow(size_t size, size_t align);
+
+public:
+    Arena(size_t block_size = 4096);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other);
+    Arena& operator=(Arena&& other);
+
+    void *allocate(size_t size, size_t align) {
+        std::uintptr_t next = (reinterpret_cast<std::uintptr_t>(m_next) + align - 1) & ~(std::uintptr_t(align) - 1);
+
+        if (next + size > reinterpret_cast<std::uintptr_t>(m_end))
+            return grow(size, align);
+
+        m_next = reinterpret_cast<std::byte*>(next + size);
+        return reinterpret_cast<void*>(next);
+    }
+
+    template <class T, class... Args>
+    T *make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "an arena never runs destructors");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // bytes reserved from the system so far
+    size_t reserved() const;
+};
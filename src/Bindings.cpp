@@ -0,0 +1,48 @@
+#include "Bindings.h"
+
+uint32_t Bindings::bind(Symbol symbol) {
+    auto [found, added] = m_slots.try_emplace(symbol, static_cast<uint32_t>(m_symbols.size()));
+    if (added) m_symbols.push_back(symbol);
+
+    return found->second;
+}
+
+uint32_t Bindings::slot(Symbol symbol) const {
+    auto found = m_slots.find(symbol);
+    return found != m_slots.end() ? found->second : NOSLOT;
+}
+
+Symbol Bindings::symbol(uint32_t slot) const {
+    return m_symbols[slot];
+}
+
+uint32_t Bindings::size() const {
+    return static_cast<uint32_t>(m_symbols.size());
+}
+
+Environment::Environment(const Bindings& bindings) : m_values(bindings.size(), 0.0), m_assigned(bindings.size(), 0) {}
+
+uint32_t Environment::size() const {
+    return static_cast<uint32_t>(m_values.size());
+}
+
+bool Environment::assigned(uint32_t slot) const {
+    return m_assigned[slot] != 0;
+}
+
+double Environment::get(uint32_t slot) const {
+    return m_values[slot];
+}
+
+void Environment::set(uint32_t slot, double value) {
+    m_values[slot] = value;
+    m_assigned[slot] = 1;
+}
+
+double *Environment::values() {
+    return m_values.data();
+}
+
+void Environment::mark(uint32_t slot) {
+    m_assigned[slot] = 1;
+}
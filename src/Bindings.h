@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Symbol.h"
+
+// gives every variable a dense slot once, ahead of evaluating, so evaluation
+// reads and writes a flat array of doubles instead of looking names up
+class Bindings {
+    std::unordered_map<Symbol, uint32_t> m_slots;
+    std::vector<Symbol> m_symbols;
+
+public:
+    static constexpr uint32_t NOSLOT = UINT32_MAX;
+
+    // the slot of `symbol`, giving it the next free one the first time
+    uint32_t bind(Symbol symbol);
+    // NOSLOT if `symbol` was never bound
+    uint32_t slot(Symbol symbol) const;
+    Symbol symbol(uint32_t slot) const;
+    uint32_t size() const;
+};
+
+// the values of bound variables by slot, and whether each has been assigned yet.
+// reading one that hasn't is an error, the same as reading a name that isn't in a map
+class Environment {
+    std::vector<double> m_values;
+    std::vector<uint8_t> m_assigned;
+
+public:
+    // a slot for every variable bound so far, none of them assigned
+    Environment(const Bindings& bindings);
+
+    uint32_t size() const;
+    bool assigned(uint32_t slot) const;
+    double get(uint32_t slot) const;
+    void set(uint32_t slot, double value);
+
+    // for evaluators that check what they read up front, and then work on the values directly
+    double *values();
+    void mark(uint32_t slot);
+};
@@ -0,0 +1,73 @@
+#include "Body.h"
+
+//=============================================================================
+// Public Functions
+//=============================================================================
+
+const std::vector<Statement>& Body::statements() const {
+    return m_statements;
+}
+
+size_t Body::folded() const {
+    return m_folded;
+}
+
+size_t Body::simplified() const {
+    return m_simplified;
+}
+
+void Body::push(LexSpan lexes, Diagnostics& diagnostics, bool fast_math) {
+    if (lexes.empty()) return;
+
+    Keyword keyword = lexes[0].keyword();
+    LexSpan rest = lexes;
+
+    switch (keyword) {
+        case Keyword::LET: case Keyword::CONST: case Keyword::RETURN: rest = lexes.slice(1, lexes.size()); break;
+        default: keyword = Keyword::NONEKWD; break;
+    }
+
+    Statement statement { keyword, lexes[0].offset(), nullptr, true };
+
+    // the expression grammar doesn't cover calls or control flow yet, so a
+    // statement it can't read is marked unparsed and only noted as a warning.
+    // whatever was built before the throw stays in the arena until the body goes
+    if (!rest.empty()) {
+        try {
+            statement.expression = Expression::parse(rest, m_arena);
+            m_folded += statement.expression->fold();
+            m_simplified += statement.expression->simplify(m_arena, fast_math);
+        } catch (ParseException& e) {
+            diagnostics.warning(statement.offset, e.what());
+            statement.parsed = false;
+        }
+    }
+
+    m_statements.push_back(statement);
+}
+
+Body Body::parse(LexSpan lexes, Diagnostics& diagnostics, bool fast_math) {
+    Body body;
+    size_t depth = 0, start = 0;
+
+    for (size_t i = 0; i < lexes.size(); i++) {
+        Op op = lexes[i].op();
+
+        if (op == Op::OPAREN || op == Op::OSTMT) depth++;
+        else if ((op == Op::CPAREN || op == Op::CSTMT) && depth > 0) depth--;
+
+        if (depth != 0) continue;
+
+        if (op == Op::SEMI) {
+            body.push(lexes.slice(start, i), diagnostics, fast_math);
+            start = i + 1;
+        } else if (op == Op::CSTMT) {
+            body.push(lexes.slice(start, i + 1), diagnostics, fast_math);
+            start = i + 1;
+        }
+    }
+
+    body.push(lexes.slice(start, lexes.size()), diagnostics, fast_math);
+
+    return body;
+}
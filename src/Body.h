@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include "Lexicon.h"
+#include "Arena.h"
+#include "Expression.h"
+#include "Diagnostics.h"
+
+// one statement of a function body
+struct Statement {
+    // LET, CONST or RETURN, NONEKWD for a bare expression
+    Keyword keyword;
+    uint32_t offset;
+
+    // null for a bare `return` or a statement that couldn't be parsed
+    Expression *expression;
+    bool parsed;
+};
+
+// the parsed statements of a function body, which owns every node of their trees
+class Body {
+    Arena m_arena;
+    std::vector<Statement> m_statements;
+    size_t m_folded = 0;
+    size_t m_simplified = 0;
+
+    void push(LexSpan lexes, Diagnostics& diagnostics, bool fast_math);
+
+public:
+    Body() = default;
+
+    Body(const Body&) = delete;
+    Body& operator=(const Body&) = delete;
+    Body(Body&&) = default;
+    Body& operator=(Body&&) = default;
+
+    // statements end at a `;` or at the `}` closing a block, outside of any brackets.
+    // `fast_math` allows rewrites that can change how results round
+    static Body parse(LexSpan lexes, Diagnostics& diagnostics, bool fast_math = false);
+
+    const std::vector<Statement>& statements() const;
+    // how many nodes constant folding took out of the statements
+    size_t folded() const;
+    // how many rewrites algebraic simplification made
+    size_t simplified() const;
+};
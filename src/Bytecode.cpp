@@ -0,0 +1,163 @@
+#include "Bytecode.h"
+#include "Dispatch.h"
+#include "Expression.h"
+#include "FlatExpression.h"
+
+#include <algorithm>
+#include <cmath>
+
+//=============================================================================
+// Constructors and Destructors
+//=============================================================================
+
+// the right operand of a binary operator is the code just before it, so when that's
+// a single PUSH or LOAD the operator can take the constant or variable itself
+void Bytecode::emit_binary(Opcode op) {
+    if (!m_code.empty() && op >= ADD && op <= DIV) {
+        Instruction last = m_code.back();
+
+        if (last.opcode == PUSH || last.opcode == LOAD) {
+            m_code.back() = { static_cast<Opcode>(op - ADD + (last.opcode == PUSH ? ADD_K : ADD_V)), last.operand };
+            return;
+        }
+    }
+
+    m_code.push_back({ op, 0 });
+}
+
+// a flat expression is already in post order, which is the order a stack machine wants its code in
+Bytecode::Bytecode(const FlatExpression& expr, Bindings& bindings) {
+    uint32_t depth = 0;
+
+    for (uint32_t i = 0; i < expr.size(); i++) {
+        switch (expr.kind(i)) {
+            case FlatExpression::SCALAR:
+                m_constants.push_back(expr.scalar(i));
+                m_code.push_back({ PUSH, static_cast<uint32_t>(m_constants.size() - 1) });
+                depth++;
+            break;
+            case FlatExpression::VARIABLE: {
+                uint32_t slot = bindings.bind(expr.symbol(i));
+
+                if (std::find(m_outputs.begin(), m_outputs.end(), slot) == m_outputs.end()
+                    && std::find(m_inputs.begin(), m_inputs.end(), slot) == m_inputs.end())
+                    m_inputs.push_back(slot);
+
+                m_code.push_back({ LOAD, slot });
+                depth++;
+            }
+            break;
+            // only the value being assigned goes on the stack
+            case FlatExpression::TARGET: break;
+            case FlatExpression::OPERATOR:
+                switch (expr.op(i)) {
+                    case Op::EQU: {
+                        uint32_t slot = bindings.bind(expr.symbol(expr.left(i)));
+
+                        if (std::find(m_outputs.begin(), m_outputs.end(), slot) == m_outputs.end())
+                            m_outputs.push_back(slot);
+
+                        m_code.push_back({ STORE, slot });
+                    }
+                    break;
+                    case Op::NOT: m_code.push_back({ NOT, 0 }); break;
+                    default:
+                        if (expr.left(i) != FlatExpression::NONODE) {
+                            emit_binary(binary_opcode<Bytecode>(expr.op(i)));
+                            depth--;
+                        }
+                        // unary + changes nothing
+                        else if (expr.op(i) == Op::SUB) m_code.push_back({ NEG, 0 });
+                        else if (expr.op(i) != Op::ADD) throw ParseException("invalid parse tree");
+                    break;
+                }
+            break;
+        }
+
+        m_max_stack = std::max(m_max_stack, depth);
+    }
+
+    if (depth != 1) throw ParseException("invalid parse tree");
+
+    m_code.push_back({ END, 0 });
+}
+
+Bytecode::Bytecode(const Expression& expr, Bindings& bindings) : Bytecode(FlatExpression(expr), bindings) {}
+
+//=============================================================================
+// Public Functions
+//=============================================================================
+
+const std::vector<Bytecode::Instruction>& Bytecode::code() const {
+    return m_code;
+}
+
+double Bytecode::run(Environment& env, Frame& frame) const {
+    for (uint32_t slot : m_inputs) {
+        if (!env.assigned(slot))
+            throw ParseException("variable does not exist");
+    }
+
+    frame.stack.resize(m_max_stack);
+
+    double *environment = env.values();
+
+    double *stack = frame.stack.data();
+    const double *constants = m_constants.data();
+
+    // the top of the stack is kept in `top` rather than memory, `below`
+    // points at the value under it
+    double top = 0.0;
+    double *below = stack;
+    const Instruction *ip = m_code.data();
+
+#ifdef QUASI_COMPUTED_GOTO
+    static const void *const handlers[] = {
+        &&do_PUSH, &&do_LOAD, &&do_STORE, &&do_NEG, &&do_NOT, &&do_ADD, &&do_SUB, &&do_MUL,
+        &&do_DIV, &&do_POW, &&do_EQ, &&do_NE, &&do_LT, &&do_GT, &&do_LE, &&do_GE,
+        &&do_ADD_K, &&do_SUB_K, &&do_MUL_K, &&do_DIV_K, &&do_ADD_V, &&do_SUB_V, &&do_MUL_V, &&do_DIV_V,
+        &&do_END,
+    };
+
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == END + 1, "every opcode needs a handler");
+#endif
+
+    DISPATCH_BEGIN
+        HANDLER(PUSH): *below++ = top; top = constants[ip->operand]; DISPATCH();
+        HANDLER(LOAD): *below++ = top; top = environment[ip->operand]; DISPATCH();
+        HANDLER(STORE): environment[ip->operand] = top; DISPATCH();
+        HANDLER(NEG): top = -top; DISPATCH();
+        HANDLER(NOT): top = top == 0.0 ? 1.0 : 0.0; DISPATCH();
+        HANDLER(ADD): top = *--below + top; DISPATCH();
+        HANDLER(SUB): top = *--below - top; DISPATCH();
+        HANDLER(MUL): top = *--below * top; DISPATCH();
+        HANDLER(DIV): top = *--below / top; DISPATCH();
+        HANDLER(POW): top = std::pow(*--below, top); DISPATCH();
+        HANDLER(EQ): top = *--below == top ? 1.0 : 0.0; DISPATCH();
+        HANDLER(NE): top = *--below != top ? 1.0 : 0.0; DISPATCH();
+        HANDLER(LT): top = *--below < top ? 1.0 : 0.0; DISPATCH();
+        HANDLER(GT): top = *--below > top ? 1.0 : 0.0; DISPATCH();
+        HANDLER(LE): top = *--below <= top ? 1.0 : 0.0; DISPATCH();
+        HANDLER(GE): top = *--below >= top ? 1.0 : 0.0; DISPATCH();
+        HANDLER(ADD_K): top = top + constants[ip->operand]; DISPATCH();
+        HANDLER(SUB_K): top = top - constants[ip->operand]; DISPATCH();
+        HANDLER(MUL_K): top = top * constants[ip->operand]; DISPATCH();
+        HANDLER(DIV_K): top = top / constants[ip->operand]; DISPATCH();
+        HANDLER(ADD_V): top = top + environment[ip->operand]; DISPATCH();
+        HANDLER(SUB_V): top = top - environment[ip->operand]; DISPATCH();
+        HANDLER(MUL_V): top = top * environment[ip->operand]; DISPATCH();
+        HANDLER(DIV_V): top = top / environment[ip->operand]; DISPATCH();
+        HANDLER(END): goto done;
+    DISPATCH_END
+
+done:
+    for (uint32_t slot : m_outputs)
+        env.mark(slot);
+
+    return top;
+}
+
+double Bytecode::run(Environment& environment) const {
+    Frame frame;
+    return run(environment, frame);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bindings.h"
+
+class Expression;
+class FlatExpression;
+
+// an expression lowered to code for a stack machine
+class Bytecode {
+public:
+    enum Opcode : uint8_t {
+        PUSH,   // push constants[operand]
+        LOAD,   // push environment[operand]
+        STORE,  // set environment[operand] to the top of the stack, leaving it there
+        NEG,
+        NOT,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        POW,
+        EQ,
+        NE,
+        LT,
+        GT,
+        LE,
+        GE,
+        // the right operand is constants[operand] or environment[operand] rather
+        // than the top of the stack, which saves pushing it
+        ADD_K, SUB_K, MUL_K, DIV_K,
+        ADD_V, SUB_V, MUL_V, DIV_V,
+        END,
+    };
+
+    struct Instruction {
+        Opcode opcode;
+        uint32_t operand;
+    };
+
+    // the value stack run works on, sized for the deepest point of the code.
+    // passing the same one to every run saves allocating it each time
+    struct Frame {
+        std::vector<double> stack;
+    };
+
+private:
+    std::vector<Instruction> m_code;
+    std::vector<double> m_constants;
+    uint32_t m_max_stack = 0;
+
+    // slots read before the code assigns them, they have to be assigned already when it's run
+    std::vector<uint32_t> m_inputs;
+    // slots the code assigns
+    std::vector<uint32_t> m_outputs;
+
+    void emit_binary(Opcode op);
+
+public:
+    // LOAD and STORE address the slots the variables are bound to in `bindings`
+    Bytecode(const FlatExpression& expr, Bindings& bindings);
+    Bytecode(const Expression& expr, Bindings& bindings);
+
+    const std::vector<Instruction>& code() const;
+
+    // reads and stores straight into `environment`, which must come from the
+    // Bindings the code was compiled with. the fused ops still compute in
+    // tree order, so the result is the one Expression::evaluate gives. every
+    // slot in m_inputs is checked first, a missing one throws before any STORE
+    double run(Environment& environment, Frame& frame) const;
+    double run(Environment& environment) const;
+};
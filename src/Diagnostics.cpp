@@ -0,0 +1,46 @@
+#include "Diagnostics.h"
+
+#include <algorithm>
+
+void Diagnostics::error(size_t offset, const char *message) {
+    m_diagnostics.push_back({ Severity::ERROR, static_cast<uint32_t>(offset), message });
+    m_errors++;
+}
+
+void Diagnostics::warning(size_t offset, const char *message) {
+    m_diagnostics.push_back({ Severity::WARNING, static_cast<uint32_t>(offset), message });
+}
+
+void Diagnostics::append(const Diagnostics& other) {
+    m_diagnostics.insert(m_diagnostics.end(), other.m_diagnostics.begin(), other.m_diagnostics.end());
+    m_errors += other.m_errors;
+}
+
+bool Diagnostics::empty() const {
+    return m_diagnostics.empty();
+}
+
+bool Diagnostics::has_errors() const {
+    return m_errors != 0;
+}
+
+const std::vector<Diagnostics::Diagnostic>& Diagnostics::all() const {
+    return m_diagnostics;
+}
+
+void Diagnostics::print(std::ostream& os, const std::string& path, LineTable& lines) const {
+    // the lexer and the parser each report in order, but the lexer goes first
+    std::vector<Diagnostic> sorted(m_diagnostics);
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Diagnostic& a, const Diagnostic& b) {
+        return a.offset < b.offset;
+    });
+
+    for (auto& diagnostic : sorted) {
+        Location loc = lines.locate(diagnostic.offset);
+
+        os << path << ":" << loc.line << ":" << loc.column << ": "
+            << (diagnostic.severity == Severity::ERROR ? "error" : "warning") << ": "
+            << diagnostic.message << std::endl;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "LineTable.h"
+
+// problems found while compiling a file. they are collected rather than
+// thrown so that one pass over a broken file reports all of them
+class Diagnostics {
+public:
+    enum Severity { ERROR, WARNING };
+
+    struct Diagnostic {
+        Severity severity;
+        uint32_t offset;
+        const char *message;
+    };
+
+    void error(size_t offset, const char *message);
+    void warning(size_t offset, const char *message);
+
+    // add everything from `other`, after what is already here
+    void append(const Diagnostics& other);
+
+    bool empty() const;
+    bool has_errors() const;
+    const std::vector<Diagnostic>& all() const;
+
+    // one `path:line:column: error: message` line per diagnostic
+    void print(std::ostream& os, const std::string& path, LineTable& lines) const;
+
+private:
+    std::vector<Diagnostic> m_diagnostics;
+    size_t m_errors = 0;
+};
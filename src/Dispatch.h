@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Expression.h"
+
+// the parts the interpreter loops of Bytecode and Program share. only meant
+// for their .cpp files, the macros below aren't prefixed
+
+// the opcode of a binary operator, for a machine whose opcodes run
+// ADD, SUB, MUL, DIV, POW, EQ, NE, LT, GT, LE, GE in that order
+template <class Machine>
+typename Machine::Opcode binary_opcode(Op op) {
+    static_assert(Machine::POW == Machine::ADD + 4 && Machine::GE == Machine::ADD + 10,
+                  "the binary opcodes have to be in the order of the switch below");
+
+    uint32_t index;
+
+    switch (op) {
+        case Op::ADD: index = 0; break;
+        case Op::SUB: index = 1; break;
+        case Op::MUL: index = 2; break;
+        case Op::DIV: index = 3; break;
+        case Op::EXP: index = 4; break;
+        case Op::BEQU: index = 5; break;
+        case Op::NEQU: index = 6; break;
+        case Op::LT: index = 7; break;
+        case Op::GT: index = 8; break;
+        case Op::LTE: index = 9; break;
+        case Op::GTE: index = 10; break;
+        default: throw ParseException("invalid parse tree");
+    }
+
+    return static_cast<typename Machine::Opcode>(Machine::ADD + index);
+}
+
+// with computed goto every handler ends in its own indirect jump rather than
+// all of them going back through the one at the top of a loop, which keeps
+// the jumps apart for the branch predictor. a loop using it names its
+// instruction pointer `ip`, and declares `handlers`, the address of every
+// handler in opcode order, when QUASI_COMPUTED_GOTO is defined:
+//
+//   DISPATCH_BEGIN
+//       HANDLER(NEG): ...; DISPATCH();
+//       ...
+//   DISPATCH_END
+#if defined(__GNUC__) || defined(__clang__)
+#define QUASI_COMPUTED_GOTO
+#endif
+
+#ifdef QUASI_COMPUTED_GOTO
+#define DISPATCH_BEGIN goto *handlers[ip->opcode]; {
+#define DISPATCH_END }
+#define HANDLER(op) do_##op
+#define DISPATCH() goto *handlers[(++ip)->opcode]
+#else
+#define DISPATCH_BEGIN for (;;) switch (ip->opcode) {
+#define DISPATCH_END }
+#define HANDLER(op) case op
+#define DISPATCH() ip++; continue
+#endif
@@ -1,7 +1,6 @@
 #include "Expression.h"
 
 #include <cmath>
-#include <stdexcept>
 
 //=============================================================================
 // Constructors and Destructors
@@ -10,25 +9,24 @@
 Expression::Expression() {}
 Expression::Expression(double scalar) : m_type(Lexicon::Type::SCALAR), m_scalar(scalar) {}
 Expression::Expression(Op op) : m_type(Lexicon::Type::OPERATOR), m_op(op) {}
-Expression::Expression(const std::string& ident) : m_type(Lexicon::Type::IDENTIFIER), m_ident(ident) {}
+Expression::Expression(Symbol ident) : m_type(Lexicon::Type::IDENTIFIER), m_ident(ident) {}
 
 Expression::Expression(const Lexicon& lex) {
     this->m_type = lex.type();
     switch (lex.type()) {
         case Lexicon::Type::SCALAR: this->m_scalar = lex.scalar();
         break;
+        case Lexicon::Type::INTEGER:
+            this->m_type = Lexicon::Type::SCALAR;
+            this->m_scalar = static_cast<double>(lex.integer());
+        break;
         case Lexicon::Type::OPERATOR: this->m_op = lex.op();
         break;
-        case Lexicon::Type::IDENTIFIER: this->m_ident = lex.ident();
+        case Lexicon::Type::IDENTIFIER: this->m_ident = lex.symbol();
         break;
     }
 }
 
-Expression::~Expression() {
-    if (left != nullptr) delete left;
-    if (right != nullptr) delete right;
-}
-
 //=============================================================================
 // Getters for union members
 //=============================================================================
@@ -41,117 +39,369 @@ Op Expression::op() const {
     return this->m_type == Lexicon::Type::OPERATOR ? std::get<Op>(m_op) : Op::NONE;
 }
 
-const std::string& Expression::ident() const {
-    return std::get<std::string>(m_ident);
+Symbol Expression::ident() const {
+    return std::get<Symbol>(m_ident);
+}
+
+bool Expression::is_scalar(double value) const {
+    return this->m_type == Lexicon::Type::SCALAR && scalar() == value;
+}
+
+bool Expression::is_zero(bool negative) const {
+    return is_scalar(0.0) && std::signbit(scalar()) == negative;
 }
 
 //=============================================================================
 // Public Functions
 //=============================================================================
 
-int Expression::precedence() const {
-    switch (op()) {
-        case Op::OPAREN: return -5;
-        case Op::EQU: return -4;
-        case Op::ADD: case Op::SUB: return -3;
-        case Op::MUL: case Op::DIV: return -2;
-        case Op::EXP: return -1;
-        default: return 0;
+// how variables are read and written is all that differs between evaluating by name and by slot
+struct Expression::Named {
+    std::unordered_map<Symbol, double>& variables;
+
+    double read(const Expression& var) {
+        auto found = variables.find(var.ident());
+
+        if (found == variables.end())
+            throw ParseException("variable does not exist");
+
+        return found->second;
     }
-}
 
-double Expression::evaluate(std::unordered_map<std::string, double>& variables) const {
-    switch (op()) {
-        case Op::ADD: {
-            if (this->left == nullptr)
-                return +this->right->evaluate(variables);
-            
-            return this->left->evaluate(variables) + this->right->evaluate(variables);
-        }
-        case Op::SUB: {
-            if (this->left == nullptr)
-                return -this->right->evaluate(variables);
-            
-            return this->left->evaluate(variables) - this->right->evaluate(variables);
-        }
-        case Op::MUL: return this->left->evaluate(variables) * this->right->evaluate(variables);
-        case Op::DIV: return this->left->evaluate(variables) / this->right->evaluate(variables);
-        case Op::EXP: return std::pow(this->left->evaluate(variables), this->right->evaluate(variables));
-        case Op::EQU: {
-            double value = this->right->evaluate(variables);
-            variables[this->left->ident()] = value;
-            return value;
+    void write(const Expression& var, double value) {
+        variables[var.ident()] = value;
+    }
+};
+
+struct Expression::Slotted {
+    Environment *environment;
+
+    double read(const Expression& var) {
+        if (var.m_slot == Bindings::NOSLOT)
+            throw ParseException("variable was never bound");
+
+        if (!environment->assigned(var.m_slot))
+            throw ParseException("variable does not exist");
+
+        return environment->get(var.m_slot);
+    }
+
+    void write(const Expression& var, double value) {
+        if (var.m_slot == Bindings::NOSLOT)
+            throw ParseException("variable was never bound");
+
+        environment->set(var.m_slot, value);
+    }
+};
+
+template <class Variables>
+double Expression::evaluate(Variables& variables) const {
+    Op op = this->op();
+
+    if (op == Op::EQU) {
+        double value = this->right->evaluate(variables);
+        variables.write(*this->left, value);
+        return value;
+    }
+
+    if (op != Op::NONE) {
+        // the left side is always evaluated first, which only matters when both sides assign
+        double l = this->left != nullptr ? this->left->evaluate(variables) : 0.0;
+        double r = this->right->evaluate(variables);
+
+        switch (op) {
+            case Op::ADD: return this->left == nullptr ? +r : l + r;
+            case Op::SUB: return this->left == nullptr ? -r : l - r;
+            case Op::MUL: return l * r;
+            case Op::DIV: return l / r;
+            case Op::EXP: return std::pow(l, r);
+            case Op::NOT: return r == 0.0 ? 1.0 : 0.0;
+            case Op::BEQU: return l == r ? 1.0 : 0.0;
+            case Op::NEQU: return l != r ? 1.0 : 0.0;
+            case Op::LT: return l < r ? 1.0 : 0.0;
+            case Op::GT: return l > r ? 1.0 : 0.0;
+            case Op::LTE: return l <= r ? 1.0 : 0.0;
+            case Op::GTE: return l >= r ? 1.0 : 0.0;
+            default: throw ParseException("invalid parse tree");
         }
-        case Op::OPAREN: return this->left->evaluate(variables);
     }
 
     switch (this->m_type) {
         case Lexicon::Type::SCALAR: return scalar();
-        case Lexicon::Type::IDENTIFIER:
-            try {
-                return variables.at(ident());
-            } catch (std::out_of_range& e) {
-                throw ParseException("variable does not exist");
-            }
+        case Lexicon::Type::IDENTIFIER: return variables.read(*this);
     }
 
     throw ParseException("invalid parse tree");
 }
 
-Expression* Expression::parse(const std::vector<Lexicon>& lex) {
-    if (lex.size() == 0) throw ParseException("expected input");
+double Expression::evaluate(std::unordered_map<Symbol, double>& variables) const {
+    Named named { variables };
+    return evaluate(named);
+}
+
+double Expression::evaluate(Environment& environment) const {
+    Slotted slotted { &environment };
+    return evaluate(slotted);
+}
+
+size_t Expression::fold() {
+    Op op = this->op();
+
+    if (op == Op::NONE) return 0;
+
+    size_t removed = 0;
+
+    if (this->left) removed += this->left->fold();
+    if (this->right) removed += this->right->fold();
+
+    // the target of an assignment is never a constant, so neither is the assignment
+    if (op == Op::EQU) return removed;
+
+    if ((this->left && this->left->m_type != Lexicon::Type::SCALAR) || this->right->m_type != Lexicon::Type::SCALAR)
+        return removed;
+
+    // evaluated the same way it would have been at run time, so the result is identical
+    Slotted none { nullptr };
+    double value = evaluate(none);
+
+    removed += this->left ? 2 : 1;
+
+    // the children stay in the arena, just unreachable
+    this->m_type = Lexicon::Type::SCALAR;
+    this->m_scalar = value;
+    this->left = this->right = nullptr;
+
+    return removed;
+}
+
+// c is a power of two whose reciprocal is exact, so x / c and x * (1 / c) round the same
+static bool exact_reciprocal(double c) {
+    int exponent;
+    return std::isfinite(c) && std::fabs(std::frexp(c, &exponent)) == 0.5 && std::isnormal(1.0 / c);
+}
+
+size_t Expression::simplify(Arena& arena, bool fast_math) {
+    Op op = this->op();
+
+    if (op == Op::NONE) return 0;
+
+    size_t rewrites = 0;
+
+    if (this->left) rewrites += this->left->simplify(arena, fast_math);
+    if (this->right) rewrites += this->right->simplify(arena, fast_math);
+
+    Expression *l = this->left, *r = this->right;
 
-    Expression* left = new Expression(lex[0]);
-    size_t pos_op = 1;
+    switch (op) {
+        case Op::ADD:
+            // +x
+            if (!l) {
+                *this = *r;
+                return rewrites + 1;
+            }
 
-    switch (left->op()) {
-        case Op::OPAREN: {
-            size_t depth = 1;
+            // adding -0 never changes x, adding 0 does when x is -0
+            if (r->is_zero(true) || (fast_math && r->is_zero(false))) {
+                *this = *l;
+                return rewrites + 1;
+            }
 
-            for (int i = 1; i < lex.size() && depth > 0; i++, pos_op++) {
-                switch (lex[i].op()) {
-                    case Op::OPAREN: depth++; break;
-                    case Op::CPAREN: depth--; break;
+            if (l->is_zero(true) || (fast_math && l->is_zero(false))) {
+                *this = *r;
+                return rewrites + 1;
+            }
+        break;
+        case Op::SUB:
+            // --x
+            if (!l) {
+                if (r->op() == Op::SUB && !r->left) {
+                    *this = *r->right;
+                    return rewrites + 1;
                 }
+
+                break;
             }
 
-            if (depth != 0)
-                throw ParseException("expected a ')' to match");
-            
-            left->left = parse(std::vector<Lexicon>(lex.begin() + 1, lex.begin() + pos_op - 1));
-        }
+            // the other way around from adding, -0 - (-0) is 0
+            if (r->is_zero(false) || (fast_math && r->is_zero(true))) {
+                *this = *l;
+                return rewrites + 1;
+            }
         break;
-        case Op::SUB: case Op::ADD: {
-            if (lex.size() < 2) throw ParseException("unary operator expected identifier or scalar");
+        case Op::MUL:
+            if (r->is_scalar(1.0)) {
+                *this = *l;
+                return rewrites + 1;
+            }
+
+            if (l->is_scalar(1.0)) {
+                *this = *r;
+                return rewrites + 1;
+            }
+        break;
+        case Op::DIV:
+            if (r->is_scalar(1.0)) {
+                *this = *l;
+                return rewrites + 1;
+            }
 
-            left->right = new Expression(lex[1]);
-            pos_op += 1;
+            if (r->m_type == Lexicon::Type::SCALAR && (exact_reciprocal(r->scalar()) || (fast_math && r->scalar() != 0.0))) {
+                r->m_scalar = 1.0 / r->scalar();
+                this->m_op = Op::MUL;
+                return rewrites + 1;
+            }
+        break;
+        case Op::EXP: {
+            if (r->m_type != Lexicon::Type::SCALAR) break;
+
+            double c = r->scalar();
+
+            if (c == 1.0) {
+                *this = *l;
+                return rewrites + 1;
+            }
+
+            // the base is used more than once, so it has to be cheap and can't assign anything
+            if (l->m_type != Lexicon::Type::IDENTIFIER) break;
+
+            // x * x is the correctly rounded square, everything past that rounds
+            // once per multiply instead of once overall
+            if (c == 2.0 || (fast_math && (c == 3.0 || c == 4.0))) {
+                Expression *product = l;
+
+                for (int n = 1; n < static_cast<int>(c); n++) {
+                    Expression *mul = arena.make<Expression>(Op::MUL);
+                    mul->left = product;
+                    mul->right = arena.make<Expression>(*l);
+                    product = mul;
+                }
+
+                *this = *product;
+                return rewrites + 1;
+            }
         }
         break;
-        case Op::NONE: break;
-        default: throw ParseException("unexpected operator, expected identifier or scalar");
     }
 
-    if (pos_op >= lex.size())
-        return left;
+    return rewrites;
+}
 
-    Expression *current = new Expression(lex[pos_op]);
+void Expression::bind(Bindings& bindings) {
+    if (this->m_type == Lexicon::Type::IDENTIFIER)
+        this->m_slot = bindings.bind(ident());
 
-    if (current->m_type != Lexicon::Type::OPERATOR) {
-        throw ParseException("expected operator");
+    if (this->left) this->left->bind(bindings);
+    if (this->right) this->right->bind(bindings);
+}
+
+static_assert(std::is_trivially_destructible_v<Expression>, "expressions live in an Arena");
+
+Expression* Expression::parse(LexSpan lex, Arena& arena) {
+    if (lex.empty()) throw ParseException("expected input");
+
+    size_t pos = 0;
+    Expression *expr = parse(lex, arena, pos, 0);
+
+    // parse only stops early at a ')' it has no '(' for
+    if (pos < lex.size())
+        throw ParseException("unexpected ')'");
+
+    return expr;
+}
+
+// how tightly an infix operator holds on to its left and right operands,
+// 0 if it isn't one. a right power below the left power makes it right associative
+struct BindingPower {
+    int left, right;
+};
+
+static constexpr BindingPower binding_powers[] = {
+    /* NONE */   { 0, 0 },
+    /* ADD */    { 7, 8 },
+    /* SUB */    { 7, 8 },
+    /* MUL */    { 9, 10 },
+    /* EXP */    { 14, 13 },
+    /* DIV */    { 9, 10 },
+    /* OPAREN */ { 0, 0 },
+    /* CPAREN */ { 0, 0 },
+    /* OSTMT */  { 0, 0 },
+    /* CSTMT */  { 0, 0 },
+    /* COLON */  { 0, 0 },
+    /* COMMA */  { 0, 0 },
+    /* SEMI */   { 0, 0 },
+    /* EQU */    { 2, 1 },
+    /* BEQU */   { 3, 4 },
+    /* NEQU */   { 3, 4 },
+    /* NOT */    { 0, 0 },
+    /* LT */     { 5, 6 },
+    /* GT */     { 5, 6 },
+    /* LTE */    { 5, 6 },
+    /* GTE */    { 5, 6 },
+};
+
+static_assert(sizeof(binding_powers) / sizeof(binding_powers[0]) == Op::GTE + 1, "every Op needs a binding power");
+
+// unary +, - and ! bind tighter than * but looser than **, so -x ** 2 is -(x ** 2)
+static constexpr int prefix_power = 11;
+
+// parses from `pos` for as long as operators bind tighter than `min_power`, leaving `pos` after the last token used
+Expression* Expression::parse(LexSpan lex, Arena& arena, size_t& pos, int min_power) {
+    if (pos >= lex.size()) throw ParseException("expected input");
+
+    const Lexicon& token = lex[pos++];
+    Expression *left;
+
+    switch (token.type()) {
+        case Lexicon::Type::SCALAR: case Lexicon::Type::INTEGER: case Lexicon::Type::IDENTIFIER:
+            left = arena.make<Expression>(token);
+        break;
+        case Lexicon::Type::OPERATOR:
+            switch (token.op()) {
+                case Op::OPAREN:
+                    left = parse(lex, arena, pos, 0);
+
+                    if (pos >= lex.size() || lex[pos].op() != Op::CPAREN)
+                        throw ParseException("expected a ')' to match");
+
+                    pos++;
+                break;
+                case Op::ADD: case Op::SUB: case Op::NOT:
+                    if (pos >= lex.size()) throw ParseException("unary operator expected identifier or scalar");
+
+                    left = arena.make<Expression>(token.op());
+                    left->right = parse(lex, arena, pos, prefix_power);
+                break;
+                default: throw ParseException("unexpected operator, expected identifier or scalar");
+            }
+        break;
+        default: throw ParseException("expected identifier or scalar");
     }
 
-    current->left = left;
+    while (pos < lex.size()) {
+        const Lexicon& next = lex[pos];
+
+        if (next.type() != Lexicon::Type::OPERATOR)
+            throw ParseException("expected operator");
+
+        // the caller decides whether this closes a '(' or is stray
+        if (next.op() == Op::CPAREN) break;
+
+        BindingPower power = binding_powers[next.op()];
+
+        if (next.op() == Op::OPAREN) throw ParseException("function calls are not supported in expressions yet");
+        if (power.left == 0) throw ParseException("unexpected operator");
+        if (power.left < min_power) break;
+
+        if (next.op() == Op::EQU && left->m_type != Lexicon::Type::IDENTIFIER)
+            throw ParseException("can only assign to a variable");
 
-    Expression* next = parse(std::vector<Lexicon>(lex.begin() + pos_op + 1, lex.end()));
+        pos++;
 
-    if (next->precedence() < current->precedence()) {
-        current->right = next->left;
-        next->left = current;
-        current = next;
-    } else {
-        current->right = next;
+        Expression *op = arena.make<Expression>(next.op());
+        op->left = left;
+        op->right = parse(lex, arena, pos, power.right);
+        left = op;
     }
 
-    return current;
+    return left;
 }
@@ -7,6 +7,8 @@
 #include <variant>
 
 #include "Lexicon.h"
+#include "Arena.h"
+#include "Bindings.h"
 
 class ParseException : public std::exception {
     const char *m_message;
@@ -17,27 +19,51 @@ public:
     const char *what() { return m_message; }
 };
 
-// represents any expression
+// represents any expression. nodes are made in an Arena, which frees a whole tree at once
 class Expression {
 public:
     Expression();
     Expression(double scalar);
     Expression(Op op);
-    Expression(const std::string& ident);
+    Expression(Symbol ident);
     Expression(const Lexicon& lex);
-    ~Expression();
 
-    double evaluate(std::unordered_map<std::string, double>& variables) const;
-    static Expression* parse(const std::vector<Lexicon>& lex);
-    int precedence() const;
+    double evaluate(std::unordered_map<Symbol, double>& variables) const;
+    // evaluate against an environment laid out by `bind`, without looking up any names
+    double evaluate(Environment& environment) const;
+    // give every variable in the tree its slot in `bindings`
+    void bind(Bindings& bindings);
+    // replace every subtree without variables or assignments by the scalar it
+    // evaluates to, returns how many nodes that removed
+    size_t fold();
+    // rewrite arithmetic into cheaper forms that give the same result bit for bit,
+    // and with `fast_math` also ones that can round differently. nodes it needs
+    // come from `arena`, returns how many rewrites were made
+    size_t simplify(Arena& arena, bool fast_math);
+    // the whole of `lex` has to be one expression, every node is allocated from `arena`
+    static Expression* parse(LexSpan lex, Arena& arena);
 
 private:
+    friend class FlatExpression;
+
     Expression *left = nullptr, *right = nullptr;
     Lexicon::Type m_type;
-    std::variant<double, Op, std::string> m_scalar, m_op, m_ident;
+    std::variant<double, Op, Symbol> m_scalar, m_op, m_ident;
+    uint32_t m_slot = Bindings::NOSLOT;
 
 private:
+    static Expression* parse(LexSpan lex, Arena& arena, size_t& pos, int min_power);
+
+    struct Named;
+    struct Slotted;
+
+    template <class Variables>
+    double evaluate(Variables& variables) const;
+
     double scalar() const;
     Op op() const;
-    const std::string& ident() const;
+    Symbol ident() const;
+
+    bool is_scalar(double value) const;
+    bool is_zero(bool negative) const;
 };
@@ -0,0 +1,156 @@
+#include "FlatExpression.h"
+#include "Expression.h"
+
+#include <cmath>
+
+//=============================================================================
+// Constructors and Destructors
+//=============================================================================
+
+FlatExpression::FlatExpression(const Expression& expr) {
+    struct Pending {
+        const Expression *expr;
+        bool expanded;
+        bool target;
+    };
+
+    // walked with explicit stacks so a long chain like 1 + 1 + ... can't
+    // overflow the call stack. `done` holds the nodes still waiting on a parent
+    std::vector<Pending> pending { { &expr, false, false } };
+    std::vector<uint32_t> done;
+
+    while (!pending.empty()) {
+        Pending next = pending.back();
+        pending.pop_back();
+
+        const Expression *e = next.expr;
+        Op op = e->op();
+
+        if (op != Op::NONE && !next.expanded) {
+            pending.push_back({ e, true, false });
+
+            if (e->right) pending.push_back({ e->right, false, false });
+            if (e->left) pending.push_back({ e->left, false, op == Op::EQU });
+
+            continue;
+        }
+
+        if (op != Op::NONE) {
+            uint32_t right = e->right ? done.back() : NONODE;
+            if (e->right) done.pop_back();
+
+            uint32_t left = e->left ? done.back() : NONODE;
+            if (e->left) done.pop_back();
+
+            done.push_back(push(OPERATOR, op, left, right, 0));
+        } else if (e->m_type == Lexicon::Type::SCALAR) {
+            m_scalars.push_back(e->scalar());
+            done.push_back(push(SCALAR, Op::NONE, NONODE, NONODE, static_cast<uint32_t>(m_scalars.size() - 1)));
+        } else if (e->m_type == Lexicon::Type::IDENTIFIER) {
+            done.push_back(push(next.target ? TARGET : VARIABLE, Op::NONE, NONODE, NONODE, e->ident()));
+        } else {
+            throw ParseException("invalid parse tree");
+        }
+    }
+}
+
+//=============================================================================
+// Getters
+//=============================================================================
+
+uint32_t FlatExpression::size() const {
+    return static_cast<uint32_t>(m_kinds.size());
+}
+
+uint32_t FlatExpression::root() const {
+    return size() - 1;
+}
+
+FlatExpression::Kind FlatExpression::kind(uint32_t node) const {
+    return m_kinds[node];
+}
+
+Op FlatExpression::op(uint32_t node) const {
+    return static_cast<Op>(m_ops[node]);
+}
+
+uint32_t FlatExpression::left(uint32_t node) const {
+    return m_left[node];
+}
+
+uint32_t FlatExpression::right(uint32_t node) const {
+    return m_right[node];
+}
+
+double FlatExpression::scalar(uint32_t node) const {
+    return m_scalars[m_payload[node]];
+}
+
+Symbol FlatExpression::symbol(uint32_t node) const {
+    return m_payload[node];
+}
+
+//=============================================================================
+// Public Functions
+//=============================================================================
+
+uint32_t FlatExpression::push(Kind kind, Op op, uint32_t left, uint32_t right, uint32_t payload) {
+    m_kinds.push_back(kind);
+    m_ops.push_back(static_cast<uint8_t>(op));
+    m_left.push_back(left);
+    m_right.push_back(right);
+    m_payload.push_back(payload);
+
+    return size() - 1;
+}
+
+double FlatExpression::evaluate(std::unordered_map<Symbol, double>& variables, std::vector<double>& values) const {
+    if (m_kinds.empty()) throw ParseException("invalid parse tree");
+
+    values.resize(size());
+
+    for (uint32_t i = 0; i < size(); i++) {
+        switch (m_kinds[i]) {
+            case SCALAR: values[i] = m_scalars[m_payload[i]]; continue;
+            case TARGET: values[i] = 0.0; continue;
+            case VARIABLE: {
+                auto found = variables.find(m_payload[i]);
+
+                if (found == variables.end())
+                    throw ParseException("variable does not exist");
+
+                values[i] = found->second;
+                continue;
+            }
+            case OPERATOR: break;
+        }
+
+        double l = m_left[i] != NONODE ? values[m_left[i]] : 0.0;
+        double r = values[m_right[i]];
+        double& result = values[i];
+
+        switch (static_cast<Op>(m_ops[i])) {
+            case Op::ADD: result = m_left[i] == NONODE ? +r : l + r; break;
+            case Op::SUB: result = m_left[i] == NONODE ? -r : l - r; break;
+            case Op::MUL: result = l * r; break;
+            case Op::DIV: result = l / r; break;
+            case Op::EXP: result = std::pow(l, r); break;
+            case Op::NOT: result = r == 0.0 ? 1.0 : 0.0; break;
+            case Op::BEQU: result = l == r ? 1.0 : 0.0; break;
+            case Op::NEQU: result = l != r ? 1.0 : 0.0; break;
+            case Op::LT: result = l < r ? 1.0 : 0.0; break;
+            case Op::GT: result = l > r ? 1.0 : 0.0; break;
+            case Op::LTE: result = l <= r ? 1.0 : 0.0; break;
+            case Op::GTE: result = l >= r ? 1.0 : 0.0; break;
+            case Op::EQU: result = variables[m_payload[m_left[i]]] = r; break;
+            default: throw ParseException("invalid parse tree");
+        }
+    }
+
+    return values.back();
+}
+
+double FlatExpression::evaluate(std::unordered_map<Symbol, double>& variables) const {
+    std::vector<double> values;
+    return evaluate(variables, values);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Lexicon.h"
+#include "Symbol.h"
+
+class Expression;
+
+// an Expression stored as parallel arrays of nodes in post order: every node
+// comes after its children and the root is last, so evaluating is one forward
+// pass. a node is 14 bytes and has no pointers, so each array can be copied or
+// written out as is
+class FlatExpression {
+public:
+    enum Kind : uint8_t {
+        SCALAR,     // payload indexes the scalar pool
+        VARIABLE,   // payload is the Symbol read
+        TARGET,     // payload is the Symbol an `=` assigns, it isn't read
+        OPERATOR,   // unary when it has no left child
+    };
+
+    static constexpr uint32_t NONODE = UINT32_MAX;
+
+private:
+    std::vector<Kind> m_kinds;
+    std::vector<uint8_t> m_ops;
+    std::vector<uint32_t> m_left, m_right;
+    std::vector<uint32_t> m_payload;
+    std::vector<double> m_scalars;
+
+    uint32_t push(Kind kind, Op op, uint32_t left, uint32_t right, uint32_t payload);
+
+public:
+    FlatExpression() = default;
+    FlatExpression(const Expression& expr);
+
+    uint32_t size() const;
+    uint32_t root() const;
+
+    Kind kind(uint32_t node) const;
+    Op op(uint32_t node) const;
+    uint32_t left(uint32_t node) const;
+    uint32_t right(uint32_t node) const;
+    double scalar(uint32_t node) const;
+    Symbol symbol(uint32_t node) const;
+
+    // the same results as Expression::evaluate. `values` is scratch space, one per node,
+    // passing the same vector in again saves allocating it every time
+    double evaluate(std::unordered_map<Symbol, double>& variables, std::vector<double>& values) const;
+    double evaluate(std::unordered_map<Symbol, double>& variables) const;
+};
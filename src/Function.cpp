@@ -1,22 +1,30 @@
 #include "Function.h"
 
-FunctionPrototype::FunctionPrototype(const std::string& ident) : m_identifier(ident), m_return_type(Type::VOID) {}
-FunctionPrototype::FunctionPrototype(const std::string& ident, Type ret) : m_identifier(ident), m_return_type(ret) {}
+FunctionPrototype::FunctionPrototype(Symbol ident) : m_identifier(ident), m_return_type(Type::VOID) {}
+FunctionPrototype::FunctionPrototype(Symbol ident, Type ret) : m_identifier(ident), m_return_type(ret) {}
 
-const std::string& FunctionPrototype::name() const {
+Symbol FunctionPrototype::symbol() const {
     return m_identifier;
 }
 
+std::string_view FunctionPrototype::name() const {
+    return SymbolTable::name(m_identifier);
+}
+
 Type FunctionPrototype::return_type() const {
     return m_return_type;
 }
 
-Function::Function(const std::string& ident) : m_prototype(FunctionPrototype(ident, Type::VOID)) {}
-Function::Function(const std::string& ident, Type ret) : m_prototype(FunctionPrototype(ident, ret)) {}
+Function::Function(Symbol ident) : m_prototype(FunctionPrototype(ident, Type::VOID)) {}
+Function::Function(Symbol ident, Type ret) : m_prototype(FunctionPrototype(ident, ret)) {}
 Function::Function(const FunctionPrototype& prototype) : m_prototype(prototype) {}
 
 
-const std::string& Function::name() const {
+Symbol Function::symbol() const {
+    return m_prototype.symbol();
+}
+
+std::string_view Function::name() const {
     return m_prototype.name();
 }
 
@@ -24,6 +32,27 @@ Type Function::return_type() const {
     return m_prototype.return_type();
 }
 
-void Function::attach_body(const std::vector<Lexicon>& body) {
-    m_body_lexes = body;
+void Function::attach_body(size_t begin, size_t end) {
+    m_body_begin = static_cast<uint32_t>(begin);
+    m_body_end = static_cast<uint32_t>(end);
+}
+
+bool Function::has_body() const {
+    return m_body_end > m_body_begin;
+}
+
+size_t Function::body_begin() const {
+    return m_body_begin;
+}
+
+size_t Function::body_end() const {
+    return m_body_end;
+}
+
+void Function::attach_ast(Body ast) {
+    m_ast = std::make_unique<Body>(std::move(ast));
+}
+
+const Body *Function::ast() const {
+    return m_ast.get();
 }
@@ -1,29 +1,44 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <optional>
+#include <memory>
 #include "Lexicon.h"
+#include "Body.h"
+#include "Symbol.h"
 
 class FunctionPrototype {
-    std::string m_identifier;
+    Symbol m_identifier;
     Type m_return_type;
 
 public:
-    FunctionPrototype(const std::string& ident, Type ret);
-    FunctionPrototype(const std::string& ident);
-    const std::string& name() const;
+    FunctionPrototype(Symbol ident, Type ret);
+    FunctionPrototype(Symbol ident);
+    Symbol symbol() const;
+    std::string_view name() const;
     Type return_type() const;
 };
 
 class Function {
     FunctionPrototype m_prototype;
-    std::optional<std::vector<Lexicon>> m_body_lexes;
+
+    // the body is lexes[m_body_begin, m_body_end) of the Source this function came from
+    uint32_t m_body_begin = 0, m_body_end = 0;
+
+    // null until the body has been parsed
+    std::unique_ptr<Body> m_ast;
 
 public:
-    Function(const std::string& ident, Type ret);
-    Function(const std::string& ident);
+    Function(Symbol ident, Type ret);
+    Function(Symbol ident);
     Function(const FunctionPrototype& prototype);
-    const std::string& name() const;
+    Symbol symbol() const;
+    std::string_view name() const;
     Type return_type() const;
-    void attach_body(const std::vector<Lexicon>& body);
+    void attach_body(size_t begin, size_t end);
+    bool has_body() const;
+    size_t body_begin() const;
+    size_t body_end() const;
+    void attach_ast(Body ast);
+    const Body *ast() const;
 };
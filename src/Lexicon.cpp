@@ -1,16 +1,33 @@
 #include "Lexicon.h"
+#include "Scan.h"
+#include "Diagnostics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <thread>
+
+#include <unistd.h>
 
-#include <unordered_map>
 
 //=============================================================================
 // Constructors and Destructors
 //=============================================================================
 
-Lexicon::Lexicon(Op op) : m_type(Type::OPERATOR), m_op(op) {}
-Lexicon::Lexicon(double scalar) : m_type(Type::SCALAR), m_scalar(scalar) {}
-Lexicon::Lexicon(Keyword kwd) : m_type(Type::KEYWORD), m_keyword(kwd) {}
-Lexicon::Lexicon(::Type type) : m_type(Type::TYPE), m_vtype(type) {}
-Lexicon::Lexicon(const std::string& ident) : m_type(Type::IDENTIFIER), m_stringdata(ident) {}
+Lexicon::Lexicon(Op op, uint32_t offset, uint32_t length)
+    : m_op(op), m_offset(offset), m_length(length), m_type(Type::OPERATOR) {}
+Lexicon::Lexicon(double scalar, uint32_t offset, uint32_t length)
+    : m_scalar(scalar), m_offset(offset), m_length(length), m_type(Type::SCALAR) {}
+Lexicon::Lexicon(uint64_t integer, uint32_t offset, uint32_t length)
+    : m_integer(integer), m_offset(offset), m_length(length), m_type(Type::INTEGER) {}
+Lexicon::Lexicon(Keyword kwd, uint32_t offset, uint32_t length)
+    : m_keyword(kwd), m_offset(offset), m_length(length), m_type(Type::KEYWORD) {}
+Lexicon::Lexicon(::Type type, uint32_t offset, uint32_t length)
+    : m_vtype(type), m_offset(offset), m_length(length), m_type(Type::TYPE) {}
+Lexicon::Lexicon(std::string_view ident, uint32_t offset, uint32_t length)
+    : m_symbol(SymbolTable::intern(ident)), m_offset(offset), m_length(length), m_type(Type::IDENTIFIER) {}
 
 //=============================================================================
 // Getters for union members
@@ -21,29 +38,50 @@ Lexicon::Type Lexicon::type() const {
 }
 
 ::Type Lexicon::vtype() const {
-    return type() == Type::TYPE ? std::get<::Type>(m_vtype) : ::Type::NONETYPE;
+    return type() == Type::TYPE ? m_vtype : ::Type::NONETYPE;
 }
 
 double Lexicon::scalar() const {
-    return std::get<double>(m_scalar);
+    return m_scalar;
+}
+
+uint64_t Lexicon::integer() const {
+    return m_integer;
+}
+
+::Type Lexicon::integer_type() const {
+    return m_integer > INT64_MAX ? ::Type::U64 : ::Type::I64;
 }
 
 Keyword Lexicon::keyword() const {
-    return type() == Type::KEYWORD ? std::get<Keyword>(m_keyword) : Keyword::NONEKWD;
+    return type() == Type::KEYWORD ? m_keyword : Keyword::NONEKWD;
+}
+
+uint32_t Lexicon::offset() const {
+    return m_offset;
+}
+
+uint32_t Lexicon::length() const {
+    return m_length;
 }
 
 Op Lexicon::op() const {
-    return type() == Type::OPERATOR ? std::get<Op>(m_op) : Op::NONE;
+    return type() == Type::OPERATOR ? m_op : Op::NONE;
+}
+
+Symbol Lexicon::symbol() const {
+    return type() == Type::IDENTIFIER ? m_symbol : NOSYMBOL;
 }
 
-const std::string& Lexicon::ident() const {
-    return std::get<std::string>(m_stringdata);
+std::string_view Lexicon::ident() const {
+    return SymbolTable::name(m_symbol);
 }
 
 std::ostream& operator<<(std::ostream& os, const Lexicon& lex) {
     switch (lex.type()) {
         case Lexicon::Type::IDENTIFIER: return os << "[ IDENT: " << lex.ident() << " ]";
         case Lexicon::Type::SCALAR: return os << "[ SCALAR: " << lex.scalar() << " ]";
+        case Lexicon::Type::INTEGER: return os << "[ INTEGER: " << lex.integer() << " ]";
         case Lexicon::Type::OPERATOR: return os << "[ OP: " << lex.op() << " ]";
         case Lexicon::Type::KEYWORD: return os << "[ KEYWORD: " << lex.keyword() << " ]";
         case Lexicon::Type::TYPE: return os << "[ TYPE: " << lex.vtype() << " ]";
@@ -56,188 +94,775 @@ std::ostream& operator<<(std::ostream& os, const Lexicon& lex) {
 // Public Functions
 //=============================================================================
 
-static std::unordered_map<std::string, Op> operators = {
-    { "+",  Op::ADD },
-    { "-",  Op::SUB },
-    { "*",  Op::MUL },
-    { "**", Op::EXP },
-    { "/",  Op::DIV },
-    { "=",  Op::EQU },
-    { "(",  Op::OPAREN },
-    { ")",  Op::CPAREN },
-    { "{",  Op::OSTMT },
-    { "}",  Op::CSTMT },
-    { ":",  Op::COLON },
-    { ",",  Op::COMMA },
-    { ";",  Op::SEMI },
-    { "==", Op::BEQU },
-    { "!=", Op::NEQU },
-    { "<", Op::LT },
-    { ">", Op::GT },
-    { "<=", Op::LTE },
-    { ">=", Op::GTE },
+//=============================================================================
+// Lexer tables
+//
+// The lexer is a DFA: every input byte is mapped to a character class, and
+// (state, class) picks the next state plus what to do with the token being
+// built. Operators get one state each so maximal munch (`**`, `==`, ...) is
+// just another transition.
+//=============================================================================
+
+namespace {
+
+enum class Class : uint8_t {
+    INVALID, SPACE, NEWLINE, ALPHA, DIGIT, DOT, HASH,
+    OPCHAR, // OPCHAR + op for every single character operator
+    COUNT = OPCHAR + Op::GTE + 1,
 };
 
-static std::string operator_chars = "+-*/=(){}:,;!<>";
+enum class State : uint8_t {
+    START, IDENT, NUMBER, COMMENT,
+    RECOVER, // skipping the rest of a word that failed to lex
+    OPERATOR, // OPERATOR + op, the operator lexed so far
+    COUNT = OPERATOR + Op::GTE + 1,
+};
 
-static std::unordered_map<std::string, Keyword> keywords = {
-    { "fn", Keyword::FN },
-    { "let", Keyword::LET },
-    { "const", Keyword::CONST },
-    { "return", Keyword::RETURN },
-    { "then", Keyword::THEN },
-    { "pub", Keyword::PUB },
+enum class Action : uint8_t {
+    SKIP,   // move to the next state, nothing else
+    BEGIN,  // a token starts at this byte
+    EMIT,   // the token ends before this byte, the next one starts here
+    FAIL,   // invalid input, next is an index into lex_errors
 };
 
-static std::unordered_map<std::string, Type> types = {
-    { "void", Type::VOID },
-    { "i8", Type::I8 },
-    { "u8", Type::U8 },
-    { "i16", Type::I16 },
-    { "u16", Type::U16 },
-    { "i32", Type::I32 },
-    { "u32", Type::U32 },
-    { "i64", Type::I64 },
-    { "u64", Type::U64 },
-    { "f32", Type::F32 },
-    { "f64", Type::F64 },
+struct Transition {
+    uint8_t next;
+    Action action;
 };
 
-// TODO: make not bad
-static bool is_valid_number(const std::string& str) {
-    bool already_hit_decimal = false;
+struct LexTables {
+    Class classes[256];
+    Transition transitions[(size_t)State::COUNT][(size_t)Class::COUNT];
+};
 
-    if (str.front() == '.' && str.back() == '.') return false;
+constexpr const char *lex_errors[] = {
+    "invalid character",
+    "invalid character in identifier",
+    "expected a digit or '.'",
+};
 
-    for (char c : str) {
-        if (c == '.')
-            if (already_hit_decimal) return false;
-            else already_hit_decimal = true;
-    }
+constexpr struct { char c; Op op; } single_ops[] = {
+    { '+', Op::ADD }, { '-', Op::SUB }, { '*', Op::MUL }, { '/', Op::DIV },
+    { '=', Op::EQU }, { '(', Op::OPAREN }, { ')', Op::CPAREN }, { '{', Op::OSTMT },
+    { '}', Op::CSTMT }, { ':', Op::COLON }, { ',', Op::COMMA }, { ';', Op::SEMI },
+    { '!', Op::NOT }, { '<', Op::LT }, { '>', Op::GT },
+};
 
-    return true;
+constexpr struct { Op first; char c; Op result; } double_ops[] = {
+    { Op::MUL, '*', Op::EXP },
+    { Op::EQU, '=', Op::BEQU },
+    { Op::NOT, '=', Op::NEQU },
+    { Op::LT, '=', Op::LTE },
+    { Op::GT, '=', Op::GTE },
+};
+
+constexpr uint8_t index(State s) { return static_cast<uint8_t>(s); }
+constexpr uint8_t index(Class c) { return static_cast<uint8_t>(c); }
+constexpr uint8_t op_state(Op op) { return index(State::OPERATOR) + op; }
+constexpr uint8_t op_class(Op op) { return index(Class::OPCHAR) + op; }
+
+constexpr bool in_token(uint8_t state) {
+    return state == index(State::IDENT) || state == index(State::NUMBER) || state >= index(State::OPERATOR);
 }
 
-std::vector<Lexicon> Lexicon::lex(const std::string& input) {
-    enum Working { NONE, IDENTIFIER, OPERATOR, NUMBER, COMMENT } current = Working::NONE;
-    std::vector<Lexicon> lexes;
-    std::string buffer;
-
-    auto pushbuffer = [&]() {
-        switch (current) {
-            case Working::NONE: throw LexException("tried to push an empty buffer to lexes");
-            case Working::IDENTIFIER:
-                if (keywords.count(buffer)) {
-                    lexes.push_back(Lexicon(keywords.at(buffer)));
-                } else if (types.count(buffer)) {
-                    lexes.push_back(Lexicon(types.at(buffer)));
-                } else {
-                    lexes.push_back(Lexicon(buffer));
-                }
-            break;
-            case Working::NUMBER:
-                if (!is_valid_number(buffer))
-                    throw LexException("invalid number");
-
-                lexes.push_back(Lexicon(std::stod(buffer)));
-            break;
-            case Working::OPERATOR: lexes.push_back(Lexicon(operators.at(buffer)));
-            break;
+constexpr LexTables build_tables() {
+    LexTables t {};
+
+    for (int c = 0; c < 256; c++) {
+        if (c == '\n') t.classes[c] = Class::NEWLINE;
+        else if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f') t.classes[c] = Class::SPACE;
+        else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) t.classes[c] = Class::ALPHA;
+        else if (c >= '0' && c <= '9') t.classes[c] = Class::DIGIT;
+        else if (c == '.') t.classes[c] = Class::DOT;
+        else if (c == '#') t.classes[c] = Class::HASH;
+        else t.classes[c] = Class::INVALID;
+    }
+
+    for (auto& op : single_ops)
+        t.classes[(unsigned char)op.c] = static_cast<Class>(op_class(op.op));
+
+    // what happens to a byte when no token is in progress
+    Transition start[(size_t)Class::COUNT] {};
+
+    for (uint8_t c = 0; c < index(Class::COUNT); c++) {
+        switch (static_cast<Class>(c)) {
+            case Class::INVALID: start[c] = { 0, Action::FAIL }; break;
+            case Class::SPACE: case Class::NEWLINE: start[c] = { index(State::START), Action::SKIP }; break;
+            case Class::HASH: start[c] = { index(State::COMMENT), Action::SKIP }; break;
+            case Class::ALPHA: start[c] = { index(State::IDENT), Action::BEGIN }; break;
+            case Class::DIGIT: case Class::DOT: start[c] = { index(State::NUMBER), Action::BEGIN }; break;
+            default: start[c] = { static_cast<uint8_t>(c - index(Class::OPCHAR) + index(State::OPERATOR)), Action::BEGIN }; break;
         }
+    }
 
-        buffer.clear();
-        current = Working::NONE;
-    };
+    // a token in progress is finished off by anything that can't extend it
+    for (uint8_t s = 0; s < index(State::COUNT); s++) {
+        for (uint8_t c = 0; c < index(Class::COUNT); c++) {
+            Transition next = start[c];
 
-    for (char c : input) {
-        switch (current) {
-            case Working::NONE: {
-                if (isalpha(c)) current = Working::IDENTIFIER;
-                else if (isalnum(c) || c == '.') current = Working::NUMBER;
-                else if (operator_chars.find(c) != std::string::npos) current = Working::OPERATOR;
-                else if (isspace(c)) continue;
-                else if (c == '#') { current = Working::COMMENT; break; }
-                else throw LexException("invalid character");
-                buffer.push_back(c);
-            }
-            break;
-            case Working::IDENTIFIER: {
-                // push buffer if whitespace
-                if (isspace(c)) pushbuffer();
-                else if (c == '#') {
-                    pushbuffer();
-                    current = Working::COMMENT;
-                }
-                else if (operator_chars.find(c) != std::string::npos) {
-                    pushbuffer();
-                    current = Working::OPERATOR;
-                    buffer.push_back(c);
-                } else if (isalnum(c)) {
-                    buffer.push_back(c);
-                } else {
-                    throw LexException("invalid character in identifier");
-                }
-            }
-            break;
-            case Working::NUMBER: {
-                if (isspace(c)) pushbuffer();
-                else if (c == '#') {
-                    pushbuffer();
-                    current = Working::COMMENT;
-                }
-                else if (isdigit(c) || c == '.') {
-                    buffer.push_back(c);
-                } else if (isalpha(c)) {
-                    throw LexException("expected a digit or '.'");
-                } else if (operator_chars.find(c) != std::string::npos) {
-                    pushbuffer();
-                    current = Working::OPERATOR;
-                    buffer.push_back(c);
-                }
-            }
-            break;
-            case Working::OPERATOR: {
-                if (
-                       buffer == "*" && c == '*'
-                    || buffer == "=" && c == '='
-                    || buffer == "!" && c == '='
-                    || buffer == ">" && c == '='
-                    || buffer == "<" && c == '='
-                ) {
-                    buffer.push_back(c);
-                } else if (isspace(c)) {
-                    pushbuffer();
-                    current = Working::NONE;
-                } else if (c == '#') {
-                    pushbuffer();
-                    current = Working::COMMENT;
-                } else if (isalpha(c)) {
-                    pushbuffer();
-                    current = Working::IDENTIFIER;
-                    buffer.push_back(c);
-                } else if (isdigit(c) || c == '.') {
-                    pushbuffer();
-                    current = Working::NUMBER;
-                    buffer.push_back(c);
-                } else if (operator_chars.find(c) != std::string::npos) {
-                    pushbuffer();
-                    current = Working::OPERATOR;
-                    buffer.push_back(c);
-                } else {
-                    throw LexException("not sure how this happened");
-                }
+            if (in_token(s) && next.action != Action::FAIL)
+                next.action = Action::EMIT;
+
+            t.transitions[s][c] = next;
+        }
+    }
+
+    auto& ident = t.transitions[index(State::IDENT)];
+    ident[index(Class::ALPHA)] = ident[index(Class::DIGIT)] = { index(State::IDENT), Action::SKIP };
+    ident[index(Class::DOT)] = ident[index(Class::INVALID)] = { 1, Action::FAIL };
+
+    auto& number = t.transitions[index(State::NUMBER)];
+    number[index(Class::DIGIT)] = number[index(Class::DOT)] = { index(State::NUMBER), Action::SKIP };
+    number[index(Class::ALPHA)] = number[index(Class::INVALID)] = { 2, Action::FAIL };
+
+    // after an error the rest of the word goes too, so one typo is one error
+    auto& recover = t.transitions[index(State::RECOVER)];
+    recover[index(Class::ALPHA)] = recover[index(Class::DIGIT)] = { index(State::RECOVER), Action::SKIP };
+    recover[index(Class::DOT)] = recover[index(Class::INVALID)] = { index(State::RECOVER), Action::SKIP };
+
+    auto& comment = t.transitions[index(State::COMMENT)];
+    for (uint8_t c = 0; c < index(Class::COUNT); c++)
+        comment[c] = { index(State::COMMENT), Action::SKIP };
+    comment[index(Class::NEWLINE)] = { index(State::START), Action::SKIP };
+
+    for (auto& op : double_ops)
+        t.transitions[op_state(op.first)][index(t.classes[(unsigned char)op.c])] = { op_state(op.result), Action::SKIP };
+
+    return t;
+}
+
+constexpr LexTables tables = build_tables();
+
+}
+
+//=============================================================================
+// Reserved words
+//
+// Keywords and type names live in one perfect hash table that is built at
+// compile time: the seed is searched for by the compiler, so a lookup is one
+// hash, one load and one compare.
+//=============================================================================
+
+namespace {
+
+struct Reserved {
+    std::string_view name;
+    Lexicon::Type kind;
+    uint8_t value;
+};
+
+constexpr Reserved reserved_words[] = {
+    { "fn", Lexicon::Type::KEYWORD, Keyword::FN },
+    { "let", Lexicon::Type::KEYWORD, Keyword::LET },
+    { "const", Lexicon::Type::KEYWORD, Keyword::CONST },
+    { "return", Lexicon::Type::KEYWORD, Keyword::RETURN },
+    { "then", Lexicon::Type::KEYWORD, Keyword::THEN },
+    { "pub", Lexicon::Type::KEYWORD, Keyword::PUB },
+
+    { "void", Lexicon::Type::TYPE, Type::VOID },
+    { "i8", Lexicon::Type::TYPE, Type::I8 },
+    { "u8", Lexicon::Type::TYPE, Type::U8 },
+    { "i16", Lexicon::Type::TYPE, Type::I16 },
+    { "u16", Lexicon::Type::TYPE, Type::U16 },
+    { "i32", Lexicon::Type::TYPE, Type::I32 },
+    { "u32", Lexicon::Type::TYPE, Type::U32 },
+    { "i64", Lexicon::Type::TYPE, Type::I64 },
+    { "u64", Lexicon::Type::TYPE, Type::U64 },
+    { "f32", Lexicon::Type::TYPE, Type::F32 },
+    { "f64", Lexicon::Type::TYPE, Type::F64 },
+};
+
+constexpr size_t reserved_min = 2, reserved_max = 6, reserved_bits = 5;
+
+constexpr uint32_t reserved_hash(std::string_view s, uint32_t seed) {
+    uint32_t key = (uint8_t)s[0] ^ ((uint8_t)s[1] << 8) ^ ((uint8_t)s.back() << 16) ^ ((uint32_t)s.size() << 24);
+    return (key * (seed * 0x9e3779b1u)) >> (32 - reserved_bits);
+}
+
+struct ReservedTable {
+    uint32_t seed;
+    Reserved slots[1 << reserved_bits];
+};
+
+constexpr ReservedTable build_reserved() {
+    for (uint32_t seed = 1; seed < 1 << 12; seed++) {
+        ReservedTable t { seed, {} };
+        bool collision = false;
+
+        for (auto& word : reserved_words) {
+            Reserved& slot = t.slots[reserved_hash(word.name, seed)];
+
+            if (!slot.name.empty()) {
+                collision = true;
+                break;
             }
-            break;
-            case Working::COMMENT: {
-                if (c == '\n') {
-                    current = Working::NONE;
-                }
+
+            slot = word;
+        }
+
+        if (!collision) return t;
+    }
+
+    return ReservedTable { 0, {} };
+}
+
+constexpr ReservedTable reserved = build_reserved();
+static_assert(reserved.seed != 0, "no perfect hash seed found for the reserved words");
+
+const Reserved *find_reserved(std::string_view word) {
+    if (word.size() < reserved_min || word.size() > reserved_max) return nullptr;
+
+    const Reserved& slot = reserved.slots[reserved_hash(word, reserved.seed)];
+    return slot.name == word ? &slot : nullptr;
+}
+
+//
+// Everything that decides which tokens come out of a given input, hashed, so
+// anything that keeps tokens around across builds can tell when they go stale.
+//
+constexpr uint32_t fnv(uint32_t h, uint32_t value) {
+    for (int i = 0; i < 4; i++, value >>= 8)
+        h = (h ^ (value & 0xff)) * 0x01000193u;
+    return h;
+}
+
+constexpr uint32_t build_fingerprint() {
+    uint32_t h = 0x811c9dc5u;
+
+    h = fnv(h, sizeof(Lexicon));
+    h = fnv(h, Op::GTE);
+    h = fnv(h, Keyword::PUB);
+    h = fnv(h, Type::VOID);
+
+    for (auto c : tables.classes)
+        h = fnv(h, index(c));
+
+    for (auto& row : tables.transitions)
+        for (auto& t : row)
+            h = fnv(h, t.next << 8 | static_cast<uint8_t>(t.action));
+
+    for (auto& word : reserved_words) {
+        for (char c : word.name)
+            h = fnv(h, static_cast<uint8_t>(c));
+        h = fnv(h, word.kind << 8 | word.value);
+    }
+
+    return h;
+}
+
+constexpr uint32_t fingerprint = build_fingerprint();
+
+}
+
+uint32_t Lexicon::tables_version() {
+    return fingerprint;
+}
+
+//=============================================================================
+// Lexer core
+//
+// The DFA can be stopped at the end of any piece of input and picked up again
+// once more arrives, which is what lets the same code lex a whole buffer or a
+// stream of chunks.
+//=============================================================================
+
+namespace {
+
+struct LexCursor {
+    uint8_t state = index(State::START);
+    size_t begin = 0; // start of the token in progress
+    size_t base = 0;  // offset of input[0] in the whole text
+
+    // where problems go, if null the first one is thrown instead
+    Diagnostics *diagnostics = nullptr;
+};
+
+void fail(const LexCursor& cursor, size_t offset, const char *message) {
+    if (cursor.diagnostics == nullptr)
+        throw LexException(message, offset);
+
+    cursor.diagnostics->error(offset, message);
+}
+
+// parse a run of [0-9.] in one pass, literals without a '.' become integers
+void push_number(std::string_view str, uint32_t offset, const LexCursor& cursor, std::vector<Lexicon>& lexes) {
+    const char *first = str.data(), *last = str.data() + str.size();
+    uint32_t length = static_cast<uint32_t>(str.size());
+
+    if (str.find('.') == std::string_view::npos) {
+        uint64_t integer;
+        auto [end, error] = std::from_chars(first, last, integer);
+
+        if (error == std::errc::result_out_of_range)
+            return fail(cursor, offset, "integer literal is too large");
+
+        lexes.push_back(Lexicon(integer, offset, length));
+        return;
+    }
+
+    double scalar;
+    auto [end, error] = std::from_chars(first, last, scalar);
+
+    if (error != std::errc() || end != last)
+        return fail(cursor, offset, "invalid number");
+
+    lexes.push_back(Lexicon(scalar, offset, length));
+}
+
+void push_token(std::string_view input, const LexCursor& cursor, size_t end, std::vector<Lexicon>& lexes) {
+    std::string_view buffer = input.substr(cursor.begin, end - cursor.begin);
+
+    if (cursor.base + cursor.begin > UINT32_MAX)
+        throw LexException("input is too large, token offsets are 32 bit", cursor.base + cursor.begin);
+
+    uint32_t offset = static_cast<uint32_t>(cursor.base + cursor.begin);
+
+    if (buffer.size() > Lexicon::max_length)
+        return fail(cursor, offset, "token is too long");
+
+    uint32_t length = static_cast<uint32_t>(buffer.size());
+
+    switch (static_cast<State>(cursor.state)) {
+        case State::START: case State::COMMENT: case State::RECOVER: throw LexException("tried to push an empty buffer to lexes");
+        case State::IDENT: {
+            const Reserved *word = find_reserved(buffer);
+
+            if (word == nullptr) {
+                lexes.push_back(Lexicon(buffer, offset, length));
+            } else if (word->kind == Lexicon::Type::KEYWORD) {
+                lexes.push_back(Lexicon(static_cast<Keyword>(word->value), offset, length));
+            } else {
+                lexes.push_back(Lexicon(static_cast<::Type>(word->value), offset, length));
             }
         }
+        break;
+        case State::NUMBER:
+            push_number(buffer, offset, cursor, lexes);
+        break;
+        default: lexes.push_back(Lexicon(static_cast<Op>(cursor.state - index(State::OPERATOR)), offset, length));
+        break;
+    }
+}
+
+// run input[from, to) through the DFA. a token is only pushed once the byte
+// after it has been seen, so the last one may be left in progress
+void lex_run(std::string_view input, size_t from, size_t to, LexCursor& cursor, std::vector<Lexicon>& lexes) {
+    const Scanner& scan = Scanner::get();
+    const char *data = input.data(), *end = data + to;
+
+    for (size_t i = from; i < to; i++) {
+        // jump over whatever can't change the state, the DFA only sees the byte that ends the run
+        switch (static_cast<State>(cursor.state)) {
+            case State::START: i = scan.skip_space(data + i, end) - data; break;
+            case State::COMMENT: i = scan.skip_comment(data + i, end) - data; break;
+            case State::IDENT: i = scan.skip_ident(data + i, end) - data; break;
+            case State::NUMBER: i = scan.skip_number(data + i, end) - data; break;
+            default: break;
+        }
+
+        if (i == to) break;
+
+        Class c = tables.classes[(unsigned char)input[i]];
+        Transition t = tables.transitions[cursor.state][index(c)];
+
+        switch (t.action) {
+            case Action::SKIP: break;
+            case Action::EMIT: push_token(input, cursor, i, lexes); // fallthrough
+            case Action::BEGIN: cursor.begin = i; break;
+            case Action::FAIL:
+                fail(cursor, cursor.base + i, lex_errors[t.next]);
+                cursor.state = index(State::RECOVER);
+                continue;
+        }
+
+        cursor.state = t.next;
     }
+}
+
+// there is no more input, so whatever token is in progress ends at `end`
+void lex_finish(std::string_view input, size_t end, LexCursor& cursor, std::vector<Lexicon>& lexes) {
+    if (in_token(cursor.state))
+        push_token(input, cursor, end, lexes);
+
+    cursor.state = index(State::START);
+}
 
-    if (!buffer.empty())
-        pushbuffer();
+// lex the whole input, on up to `jobs` threads if it's big enough to be worth splitting
+std::vector<Lexicon> lex_all(std::string_view input, unsigned jobs, Diagnostics *diagnostics) {
+    // splitting anything smaller costs more in thread startup than it saves
+    constexpr size_t min_segment = 1 << 16;
+
+    size_t count = std::min<size_t>(jobs, input.size() / min_segment);
+
+    if (count <= 1) {
+        std::vector<Lexicon> lexes;
+        LexCursor cursor;
+        cursor.diagnostics = diagnostics;
+
+        lex_run(input, 0, input.size(), cursor, lexes);
+        lex_finish(input, input.size(), cursor, lexes);
+
+        return lexes;
+    }
+
+    // a comment ends at its newline and no token can contain one, so the lexer
+    // is always back in START at the beginning of a line. segments split just
+    // after a '\n' can be lexed on their own and simply concatenated.
+    std::vector<size_t> bounds { 0 };
+
+    for (size_t i = 1; i < count; i++) {
+        size_t split = input.find('\n', std::max(bounds.back(), input.size() / count * i));
+        if (split == std::string_view::npos) break;
+
+        bounds.push_back(split + 1);
+    }
+
+    bounds.push_back(input.size());
+
+    size_t segments = bounds.size() - 1;
+    std::vector<std::vector<Lexicon>> parts(segments);
+    std::vector<Diagnostics> reports(segments);
+    std::vector<std::exception_ptr> errors(segments);
+
+    auto work = [&](size_t n) {
+        try {
+            LexCursor cursor;
+            cursor.diagnostics = diagnostics ? &reports[n] : nullptr;
+
+            lex_run(input, bounds[n], bounds[n + 1], cursor, parts[n]);
+            lex_finish(input, bounds[n + 1], cursor, parts[n]);
+        } catch (...) {
+            errors[n] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (size_t n = 1; n < segments; n++)
+        threads.emplace_back(work, n);
+
+    work(0);
+
+    for (auto& thread : threads)
+        thread.join();
+
+    // the sequential lexer would have stopped at the earliest error
+    for (auto& error : errors)
+        if (error) std::rethrow_exception(error);
+
+    if (diagnostics) {
+        for (auto& report : reports)
+            diagnostics->append(report);
+    }
+
+    size_t total = 0;
+    for (auto& part : parts) total += part.size();
+
+    std::vector<Lexicon> lexes;
+    lexes.reserve(total);
+
+    for (auto& part : parts)
+        lexes.insert(lexes.end(), part.begin(), part.end());
+
+    return lexes;
+}
+
+}
+
+std::vector<Lexicon> Lexicon::lex(std::string_view input) {
+    return lex_all(input, 1, nullptr);
+}
+
+std::vector<Lexicon> Lexicon::lex(std::string_view input, unsigned jobs) {
+    return lex_all(input, jobs, nullptr);
+}
+
+std::vector<Lexicon> Lexicon::lex(std::string_view input, Diagnostics& diagnostics, unsigned jobs) {
+    return lex_all(input, jobs, &diagnostics);
+}
+
+//=============================================================================
+// LexBuffer
+//
+// Tokens live in blocks of a few hundred, with offsets relative to the first
+// token of their block. Blocks after the gap store how far they start from the
+// end of the text and of the token list rather than from the beginning, so an
+// edit that grows or shrinks the text leaves every block after it alone. The
+// gap follows the edits; moving it costs one subtraction per block it passes.
+//=============================================================================
+
+namespace {
+
+// blocks are split above max_block tokens and merged below min_block
+constexpr size_t block_size = 256, max_block = 2 * block_size, min_block = block_size / 4;
+
+// the lines `edit` touched, lexed again. [restart, resume) is where they were
+// in the text before the edit
+std::vector<Lexicon> relex_lines(std::string_view input, const Lexicon::Edit& edit, Diagnostics *diagnostics,
+                                 size_t& restart, size_t& resume) {
+    // the lexer is back in START at every line break (see the parallel lexer),
+    // so lexing can restart at the line the edit begins on and stop after the
+    // line it ends on. everything outside of that is the old tokens, moved over
+    size_t edit_end = edit.offset + edit.inserted.size();
+    restart = edit.offset == 0 ? std::string_view::npos : input.rfind('\n', edit.offset - 1);
+    resume = input.find('\n', edit_end);
+
+    restart = restart == std::string_view::npos ? 0 : restart + 1;
+    resume = resume == std::string_view::npos ? input.size() : resume + 1;
+
+    std::vector<Lexicon> lines;
+    LexCursor cursor;
+    cursor.diagnostics = diagnostics;
+
+    lex_run(input, restart, resume, cursor, lines);
+    lex_finish(input, resume, cursor, lines);
+
+    resume = resume - edit.inserted.size() + edit.removed;
+    return lines;
+}
+
+}
+
+LexBuffer::LexBuffer(std::string_view input) {
+    replace(0, 0, input.size(), Lexicon::lex(input));
+}
+
+LexBuffer::LexBuffer(std::string_view input, Diagnostics& diagnostics) {
+    if (input.size() > UINT32_MAX) {
+        diagnostics.error(0, "input is too large, token offsets are 32 bit");
+        return;
+    }
+
+    replace(0, 0, input.size(), Lexicon::lex(input, diagnostics));
+}
+
+void LexBuffer::relex(std::string_view input, const Lexicon::Edit& edit) {
+    if (input.size() > UINT32_MAX)
+        throw LexException("input is too large, token offsets are 32 bit");
+
+    size_t restart, resume;
+    std::vector<Lexicon> lines = relex_lines(input, edit, nullptr, restart, resume);
+
+    replace(restart, resume, input.size(), lines);
+}
+
+void LexBuffer::relex(std::string_view input, const Lexicon::Edit& edit, Diagnostics& diagnostics) {
+    if (input.size() > UINT32_MAX) {
+        diagnostics.error(0, "input is too large, token offsets are 32 bit");
+        return;
+    }
+
+    size_t restart, resume;
+    std::vector<Lexicon> lines = relex_lines(input, edit, &diagnostics, restart, resume);
+
+    replace(restart, resume, input.size(), lines);
+}
+
+Lexicon LexBuffer::operator[](size_t i) const {
+    size_t low = 0, high = m_blocks.size();
+
+    // the last block whose first token is at or before i
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+
+        if (first(mid) <= i) low = mid;
+        else high = mid;
+    }
+
+    Lexicon lex = m_blocks[low].lexes[i - first(low)];
+    lex.m_offset += static_cast<uint32_t>(offset(low));
+
+    return lex;
+}
+
+std::vector<Lexicon> LexBuffer::lexes() const {
+    std::vector<Lexicon> lexes;
+    lexes.reserve(m_count);
+
+    for (size_t b = 0; b < m_blocks.size(); b++) {
+        uint32_t base = static_cast<uint32_t>(offset(b));
+
+        for (Lexicon lex : m_blocks[b].lexes) {
+            lex.m_offset += base;
+            lexes.push_back(lex);
+        }
+    }
 
     return lexes;
 }
+
+size_t LexBuffer::offset(size_t block) const {
+    return block < m_gap ? m_blocks[block].offset : m_size - m_blocks[block].offset;
+}
+
+size_t LexBuffer::first(size_t block) const {
+    return block < m_gap ? m_blocks[block].first : m_count - m_blocks[block].first;
+}
+
+size_t LexBuffer::block_at(size_t at) const {
+    size_t low = 0, high = m_blocks.size();
+
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+
+        if (offset(mid) <= at) low = mid;
+        else high = mid;
+    }
+
+    return low;
+}
+
+void LexBuffer::move_gap(size_t block) {
+    for (; m_gap < block; m_gap++) {
+        Block& b = m_blocks[m_gap];
+        b.offset = static_cast<uint32_t>(m_size - b.offset);
+        b.first = m_count - b.first;
+    }
+
+    for (; m_gap > block; m_gap--) {
+        Block& b = m_blocks[m_gap - 1];
+        b.offset = static_cast<uint32_t>(m_size - b.offset);
+        b.first = m_count - b.first;
+    }
+}
+
+void LexBuffer::replace(size_t restart, size_t resume, size_t size, const std::vector<Lexicon>& lines) {
+    // the blocks holding tokens from [restart, resume), plus a neighbour if they'd end up too small
+    size_t from = 0, to = 0;
+
+    if (!m_blocks.empty()) {
+        from = block_at(restart);
+        to = std::max(from, resume == 0 ? 0 : block_at(resume - 1)) + 1;
+
+        size_t tokens = lines.size();
+        for (size_t b = from; b < to; b++) tokens += m_blocks[b].lexes.size();
+
+        if (tokens < min_block && to < m_blocks.size()) to++;
+    }
+
+    move_gap(from);
+
+    // the tokens before `restart` are kept, the ones after `resume` moved by the change in length
+    uint32_t delta = static_cast<uint32_t>(size - m_size);
+    size_t index = from < m_blocks.size() ? first(from) : m_count;
+    size_t removed = 0;
+
+    std::vector<Lexicon> before, after;
+
+    for (size_t b = from; b < to; b++) {
+        size_t base = offset(b);
+        removed += m_blocks[b].lexes.size();
+
+        for (Lexicon lex : m_blocks[b].lexes) {
+            size_t at = base + lex.m_offset;
+
+            if (at < restart) {
+                lex.m_offset = static_cast<uint32_t>(at);
+                before.push_back(lex);
+            } else if (at >= resume) {
+                lex.m_offset = static_cast<uint32_t>(at) + delta;
+                after.push_back(lex);
+            }
+        }
+    }
+
+    before.insert(before.end(), lines.begin(), lines.end());
+    before.insert(before.end(), after.begin(), after.end());
+
+    // cut what's left into even blocks, all of them before the gap
+    size_t pieces = before.empty() ? 0 : (before.size() + max_block - 1) / max_block;
+    std::vector<Block> blocks(pieces);
+
+    for (size_t p = 0, at = 0; p < pieces; p++) {
+        size_t end = before.size() * (p + 1) / pieces;
+        Block& block = blocks[p];
+
+        block.offset = before[at].m_offset;
+        block.first = index + at;
+        block.lexes.assign(before.begin() + at, before.begin() + end);
+
+        for (auto& lex : block.lexes)
+            lex.m_offset -= block.offset;
+
+        at = end;
+    }
+
+    // only the blocks that were replaced are touched, unless their number changed
+    size_t common = std::min(to - from, pieces);
+    std::move(blocks.begin(), blocks.begin() + common, m_blocks.begin() + from);
+
+    if (pieces > to - from) {
+        m_blocks.insert(m_blocks.begin() + from + common, std::make_move_iterator(blocks.begin() + common),
+                        std::make_move_iterator(blocks.end()));
+    } else {
+        m_blocks.erase(m_blocks.begin() + from + common, m_blocks.begin() + to);
+    }
+
+    m_gap = from + pieces;
+    m_size = size;
+    m_count = m_count - removed + before.size();
+}
+
+//=============================================================================
+// LexStream
+//=============================================================================
+
+LexStream::LexStream(int fd, size_t chunk_size) : m_fd(fd), m_chunk_size(chunk_size) {}
+
+LexStream::LexStream(int fd, Diagnostics& diagnostics, size_t chunk_size)
+    : m_fd(fd), m_chunk_size(chunk_size), m_diagnostics(&diagnostics) {}
+
+bool LexStream::refill() {
+    if (m_eof) return false;
+
+    m_lexes.clear();
+    m_next = 0;
+
+    // an unfinished token is moved to the front, the next chunk is read in after it
+    size_t carry = in_token(m_state) ? m_size - m_begin : 0;
+
+    m_base += m_size - carry;
+
+    if (carry) std::memmove(m_buffer.data(), m_buffer.data() + m_begin, carry);
+    if (m_buffer.size() < carry + m_chunk_size) m_buffer.resize(carry + m_chunk_size);
+
+    ssize_t count;
+    do {
+        count = read(m_fd, m_buffer.data() + carry, m_chunk_size);
+    } while (count < 0 && errno == EINTR);
+
+    if (count < 0)
+        throw LexException("failed to read input");
+
+    m_size = carry + count;
+
+    std::string_view input(m_buffer.data(), m_size);
+    LexCursor cursor { m_state, 0, m_base, m_diagnostics };
+
+    if (count == 0) {
+        m_eof = true;
+        lex_finish(input, m_size, cursor, m_lexes);
+    } else {
+        lex_run(input, carry, m_size, cursor, m_lexes);
+    }
+
+    m_state = cursor.state;
+    m_begin = cursor.begin;
+
+    return true;
+}
+
+const Lexicon *LexStream::next() {
+    while (m_next == m_lexes.size())
+        if (!refill()) return nullptr;
+
+    return &m_lexes[m_next++];
+}
+
+LexStream::iterator LexStream::begin() {
+    return iterator(this, next());
+}
+
+LexStream::iterator LexStream::end() {
+    return iterator(this, nullptr);
+}
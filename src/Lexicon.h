@@ -1,10 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <exception>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <variant>
 #include <fstream>
+#include <iterator>
+
+#include "Symbol.h"
 
 enum Type {
     NONETYPE,
@@ -106,35 +110,211 @@ static std::ostream& operator<<(std::ostream& os, Keyword kwd) {
     return os;
 }
 
+class Diagnostics;
+
 class LexException : public std::exception {
     const char *m_message;
+    size_t m_offset;
 
 public:
-    LexException(const char *msg) : m_message(msg) {}
+    LexException(const char *msg, size_t offset = 0) : m_message(msg), m_offset(offset) {}
 
     const char *what() { return m_message; }
+
+    // where in the input the problem is
+    size_t offset() const { return m_offset; }
 };
 
 class Lexicon {
 public:
-    Lexicon(Op op);
-    Lexicon(double scalar);
-    Lexicon(Keyword kwd);
-    Lexicon(::Type type);
-    Lexicon(const std::string& ident);
+    // the token is the `length` bytes at `offset` in the lexed text
+    Lexicon(Op op, uint32_t offset = 0, uint32_t length = 0);
+    Lexicon(double scalar, uint32_t offset = 0, uint32_t length = 0);
+    Lexicon(uint64_t integer, uint32_t offset = 0, uint32_t length = 0);
+    Lexicon(Keyword kwd, uint32_t offset = 0, uint32_t length = 0);
+    Lexicon(::Type type, uint32_t offset = 0, uint32_t length = 0);
+    Lexicon(std::string_view ident, uint32_t offset = 0, uint32_t length = 0);
+
+    // longest token that can still report its length
+    static constexpr uint32_t max_length = (1 << 24) - 1;
+
+    static std::vector<Lexicon> lex(std::string_view input);
+    // same tokens as lex(input), but large inputs are split at line breaks and lexed on up to `jobs` threads
+    static std::vector<Lexicon> lex(std::string_view input, unsigned jobs);
+    // lex everything that can be lexed, reporting each problem to `diagnostics` instead of throwing the first
+    static std::vector<Lexicon> lex(std::string_view input, Diagnostics& diagnostics, unsigned jobs = 1);
+
+    // `removed` bytes at `offset` were replaced with `inserted`, see LexBuffer
+    struct Edit {
+        size_t offset;
+        size_t removed;
+        std::string_view inserted;
+    };
 
-    static std::vector<Lexicon> lex(const std::string& input);
+    // a hash of the lexer tables, reserved words and token enums. it changes
+    // whenever they do, so tokens saved by another build can be recognised
+    static uint32_t tables_version();
 
-    enum Type { SCALAR, OPERATOR, IDENTIFIER, TYPE, KEYWORD };
+    enum Type : uint8_t { SCALAR, INTEGER, OPERATOR, IDENTIFIER, TYPE, KEYWORD };
     Type type() const;
     ::Type vtype() const;
     double scalar() const;
+    uint64_t integer() const;
+    // i64 if the literal fits in one, u64 otherwise
+    ::Type integer_type() const;
     Op op() const;
     Keyword keyword() const;
-    const std::string& ident() const;
+    uint32_t offset() const;
+    uint32_t length() const;
+    Symbol symbol() const;
+    std::string_view ident() const;
 
 private:
-    Type m_type;
-    std::variant<double, Op, Keyword, ::Type, std::string> m_scalar, m_op, m_keyword, m_vtype, m_stringdata;
+    // only one of these is ever live, m_type says which
+    union {
+        double m_scalar;
+        uint64_t m_integer;
+        Op m_op;
+        Keyword m_keyword;
+        ::Type m_vtype;
+        Symbol m_symbol;
+    };
+
+    uint32_t m_offset;
+    uint32_t m_length : 24;
+    Type m_type : 8;
+
     friend std::ostream& operator<<(std::ostream& os, const Lexicon& lex);
+
+    // writes tokens to disk as they are, renumbering identifiers
+    friend class TokenCache;
+    // stores offsets relative to a block of tokens
+    friend class LexBuffer;
+};
+
+static_assert(sizeof(Lexicon) == 16, "tokens are stored by the million, keep them small");
+
+// a run of tokens inside someone else's buffer, for passing parts of a token
+// stream around without copying them
+class LexSpan {
+    const Lexicon *m_begin = nullptr, *m_end = nullptr;
+
+public:
+    LexSpan() = default;
+    LexSpan(const Lexicon *begin, const Lexicon *end) : m_begin(begin), m_end(end) {}
+    LexSpan(const std::vector<Lexicon>& lexes) : m_begin(lexes.data()), m_end(lexes.data() + lexes.size()) {}
+
+    const Lexicon *begin() const { return m_begin; }
+    const Lexicon *end() const { return m_end; }
+    size_t size() const { return m_end - m_begin; }
+    bool empty() const { return m_begin == m_end; }
+    const Lexicon& operator[](size_t i) const { return m_begin[i]; }
+
+    // the tokens in [from, to)
+    LexSpan slice(size_t from, size_t to) const { return LexSpan(m_begin + from, m_begin + to); }
+};
+
+// the tokens of a text that is being edited. an edit costs about as much as
+// lexing the lines it touched, however long the rest of the text is
+class LexBuffer {
+public:
+    LexBuffer() = default;
+    // throws like Lexicon::lex
+    explicit LexBuffer(std::string_view input);
+    // problems are reported to `diagnostics` instead of being thrown
+    LexBuffer(std::string_view input, Diagnostics& diagnostics);
+
+    // bring the tokens up to date with `input`, the text after `edit`. only the
+    // lines the edit touched are lexed again. if they no longer lex, this throws
+    // and the tokens are left as they were
+    void relex(std::string_view input, const Lexicon::Edit& edit);
+    // same, but problems in those lines are reported to `diagnostics` and
+    // whatever still lexes replaces them, so half typed text never throws
+    void relex(std::string_view input, const Lexicon::Edit& edit, Diagnostics& diagnostics);
+
+    size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    // the i'th token, with its offset in the whole text
+    Lexicon operator[](size_t i) const;
+    // every token, in order
+    std::vector<Lexicon> lexes() const;
+
+private:
+    // a run of tokens whose offsets are relative to the first one. blocks
+    // before the gap know where they start, blocks after it only how far
+    // their start is from the end of the text and of the token list
+    struct Block {
+        uint32_t offset;
+        size_t first;
+        std::vector<Lexicon> lexes;
+    };
+
+    size_t offset(size_t block) const;
+    size_t first(size_t block) const;
+    // the last block starting at or before `offset`
+    size_t block_at(size_t offset) const;
+    void move_gap(size_t block);
+    // the tokens in [restart, resume) were lexed again as `lines`
+    void replace(size_t restart, size_t resume, size_t size, const std::vector<Lexicon>& lines);
+
+    std::vector<Block> m_blocks;
+    size_t m_gap = 0;
+    size_t m_size = 0;  // of the text
+    size_t m_count = 0; // of the tokens
+};
+
+// pulls tokens out of a file descriptor one fixed size chunk at a time, so
+// memory use does not depend on the size of the input. a token split across
+// two chunks is carried over, comments and whitespace never are.
+class LexStream {
+public:
+    LexStream(int fd, size_t chunk_size = 64 * 1024);
+    // problems are reported to `diagnostics` instead of being thrown
+    LexStream(int fd, Diagnostics& diagnostics, size_t chunk_size = 64 * 1024);
+
+    // the next token, or nullptr once the input is exhausted.
+    // it stays valid until the next call
+    const Lexicon *next();
+
+    class iterator {
+        LexStream *m_stream;
+        const Lexicon *m_current;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Lexicon;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Lexicon *;
+        using reference = const Lexicon&;
+
+        iterator(LexStream *stream, const Lexicon *current) : m_stream(stream), m_current(current) {}
+
+        reference operator*() const { return *m_current; }
+        pointer operator->() const { return m_current; }
+        iterator& operator++() { m_current = m_stream->next(); return *this; }
+        bool operator==(const iterator& other) const { return m_current == other.m_current; }
+        bool operator!=(const iterator& other) const { return m_current != other.m_current; }
+    };
+
+    iterator begin();
+    iterator end();
+
+private:
+    bool refill();
+
+    int m_fd;
+    size_t m_chunk_size;
+
+    std::vector<char> m_buffer; // the unfinished token from last chunk, then this chunk
+    size_t m_size = 0;
+
+    std::vector<Lexicon> m_lexes; // tokens lexed out of the buffer
+    size_t m_next = 0;
+
+    uint8_t m_state = 0; // where the lexer stopped
+    size_t m_begin = 0;
+    size_t m_base = 0; // offset of m_buffer[0] in the file
+    bool m_eof = false;
+
+    Diagnostics *m_diagnostics = nullptr;
 };
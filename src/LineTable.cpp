@@ -0,0 +1,27 @@
+#include "LineTable.h"
+
+#include <algorithm>
+#include <cstring>
+
+LineTable::LineTable(std::string_view text) : m_text(text) {}
+
+Location LineTable::locate(uint32_t offset) {
+    if (!m_built) {
+        const char *begin = m_text.data(), *end = begin + m_text.size();
+
+        m_starts.push_back(0);
+
+        for (const char *p = begin; (p = static_cast<const char *>(std::memchr(p, '\n', end - p))) != nullptr; p++)
+            m_starts.push_back(static_cast<uint32_t>(p - begin + 1));
+
+        m_built = true;
+    }
+
+    // the last line starting at or before offset
+    auto line = std::upper_bound(m_starts.begin(), m_starts.end(), offset) - 1;
+
+    return Location {
+        static_cast<uint32_t>(line - m_starts.begin() + 1),
+        offset - *line + 1,
+    };
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// 1 based line and column of a byte in the source
+struct Location {
+    uint32_t line;
+    uint32_t column;
+};
+
+// turns token offsets back into lines and columns. nothing is scanned until
+// the first lookup, so code that never reports a location never pays for it
+class LineTable {
+    std::string_view m_text;
+    std::vector<uint32_t> m_starts; // offset of the first byte of every line
+    bool m_built = false;
+
+public:
+    LineTable(std::string_view text);
+
+    Location locate(uint32_t offset);
+};
@@ -0,0 +1,44 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+
+    if (fstat(fd, &st) == 0) {
+        m_size = static_cast<size_t>(st.st_size);
+
+        // mmap refuses empty mappings, an empty file is still a valid file
+        if (m_size == 0) {
+            m_open = true;
+        } else {
+            void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (data != MAP_FAILED) {
+                m_data = static_cast<const char *>(data);
+                m_open = true;
+            }
+        }
+    }
+
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr)
+        munmap(const_cast<char *>(m_data), m_size);
+}
+
+bool MappedFile::is_open() const {
+    return m_open;
+}
+
+std::string_view MappedFile::contents() const {
+    return std::string_view(m_data, m_size);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// read only view of an entire file, mapped rather than copied into memory
+class MappedFile {
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    bool m_open = false;
+
+public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() const;
+    std::string_view contents() const;
+};
@@ -0,0 +1,303 @@
+#include "Program.h"
+#include "Body.h"
+#include "Dispatch.h"
+#include "Expression.h"
+#include "FlatExpression.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+//=============================================================================
+// Compiler
+//=============================================================================
+
+// while compiling, operands say which bank of registers they're in, because
+// where the variables and temporaries start isn't known until the end
+static constexpr uint32_t CONSTANT = 0u << 30, VARIABLE = 1u << 30, TEMPORARY = 2u << 30;
+static constexpr uint32_t BANK = 3u << 30;
+
+class ProgramCompiler {
+    Program& m_program;
+    Bindings& m_bindings;
+
+    std::unordered_map<uint64_t, uint32_t> m_constants; // by bit pattern, so -0.0 and 0.0 stay apart
+    std::unordered_map<uint32_t, uint32_t> m_variables; // by slot
+    std::vector<bool> m_assigned, m_input;
+
+    // values computed but not used yet, in the order a stack machine would hold them
+    std::vector<uint32_t> m_operands;
+    std::vector<uint32_t> m_free;
+    uint32_t m_temporaries = 0;
+
+    uint32_t constant(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+
+        auto [found, added] = m_constants.try_emplace(bits, static_cast<uint32_t>(m_program.m_constants.size()));
+        if (added) m_program.m_constants.push_back(value);
+
+        return CONSTANT | found->second;
+    }
+
+    uint32_t variable(Symbol symbol) {
+        uint32_t slot = m_bindings.bind(symbol);
+        auto [found, added] = m_variables.try_emplace(slot, static_cast<uint32_t>(m_program.m_variables.size()));
+
+        if (added) {
+            m_program.m_variables.push_back(slot);
+            m_assigned.push_back(false);
+            m_input.push_back(false);
+        }
+
+        return found->second;
+    }
+
+    uint32_t temporary() {
+        if (m_free.empty()) return TEMPORARY | m_temporaries++;
+
+        uint32_t reg = m_free.back();
+        m_free.pop_back();
+        return reg;
+    }
+
+    void release(uint32_t operand) {
+        if ((operand & BANK) == TEMPORARY) m_free.push_back(operand);
+    }
+
+    uint32_t pop() {
+        uint32_t operand = m_operands.back();
+        m_operands.pop_back();
+        return operand;
+    }
+
+    void emit(Program::Opcode opcode, uint32_t dst, uint32_t a = CONSTANT, uint32_t b = CONSTANT) {
+        m_program.m_code.push_back({ opcode, dst, a, b });
+    }
+
+public:
+    ProgramCompiler(Program& program, Bindings& bindings) : m_program(program), m_bindings(bindings) {}
+
+    // the operand holding the value of `expr`
+    uint32_t expression(const FlatExpression& expr) {
+        for (uint32_t i = 0; i < expr.size(); i++) {
+            switch (expr.kind(i)) {
+                case FlatExpression::SCALAR: m_operands.push_back(constant(expr.scalar(i))); break;
+                case FlatExpression::VARIABLE: {
+                    uint32_t v = variable(expr.symbol(i));
+
+                    if (!m_assigned[v] && !m_input[v]) {
+                        m_input[v] = true;
+                        m_program.m_inputs.push_back(v);
+                    }
+
+                    m_operands.push_back(VARIABLE | v);
+                }
+                break;
+                case FlatExpression::TARGET: break;
+                case FlatExpression::OPERATOR: {
+                    Op op = expr.op(i);
+
+                    if (op == Op::EQU) {
+                        uint32_t value = pop();
+                        uint32_t v = variable(expr.symbol(expr.left(i)));
+
+                        // reads of the variable still waiting to be used keep the old value
+                        for (auto& operand : m_operands) {
+                            if (operand == (VARIABLE | v)) {
+                                uint32_t copy = temporary();
+                                emit(Program::MOV, copy, operand);
+                                operand = copy;
+                            }
+                        }
+
+                        if (value != (VARIABLE | v)) emit(Program::MOV, VARIABLE | v, value);
+                        release(value);
+
+                        if (!m_assigned[v]) {
+                            m_assigned[v] = true;
+                            m_program.m_outputs.push_back(v);
+                        }
+
+                        m_operands.push_back(VARIABLE | v);
+                    } else if (expr.left(i) == FlatExpression::NONODE) {
+                        // unary + changes nothing
+                        if (op == Op::ADD) break;
+
+                        uint32_t a = pop();
+                        release(a);
+
+                        uint32_t dst = temporary();
+                        emit(op == Op::NOT ? Program::NOT : Program::NEG, dst, a);
+                        m_operands.push_back(dst);
+                    } else {
+                        uint32_t b = pop(), a = pop();
+                        release(b);
+                        release(a);
+
+                        uint32_t dst = temporary();
+                        emit(binary_opcode<Program>(op), dst, a, b);
+                        m_operands.push_back(dst);
+                    }
+                }
+                break;
+            }
+        }
+
+        return pop();
+    }
+
+    // the code is straight line, so nothing after the first return can run. it isn't
+    // compiled, and what it would read or assign doesn't count as an input or output
+    void statements(const Body& body) {
+        for (auto& statement : body.statements()) {
+            if (!statement.parsed)
+                throw ParseException("can't compile a body with statements that couldn't be parsed");
+
+            // a bare `return`
+            if (statement.expression == nullptr) {
+                if (statement.keyword != Keyword::RETURN) continue;
+
+                ret(constant(0.0));
+                return;
+            }
+
+            uint32_t value = expression(FlatExpression(*statement.expression));
+
+            if (statement.keyword == Keyword::RETURN) {
+                ret(value);
+                return;
+            }
+
+            release(value);
+        }
+
+        emit(Program::END, CONSTANT);
+    }
+
+    void ret(uint32_t value) {
+        emit(Program::RET, CONSTANT, value);
+    }
+
+    // give every operand its final register
+    void finish() {
+        uint32_t constants = static_cast<uint32_t>(m_program.m_constants.size());
+        uint32_t variables = static_cast<uint32_t>(m_program.m_variables.size());
+
+        auto relocate = [&](uint32_t& operand) {
+            uint32_t index = operand & ~BANK;
+
+            switch (operand & BANK) {
+                case CONSTANT: operand = index; break;
+                case VARIABLE: operand = constants + index; break;
+                default: operand = constants + variables + index; break;
+            }
+        };
+
+        for (auto& in : m_program.m_code) {
+            relocate(in.dst);
+            relocate(in.a);
+            relocate(in.b);
+        }
+
+        m_program.m_registers = constants + variables + m_temporaries;
+    }
+};
+
+//=============================================================================
+// Constructors and Destructors
+//=============================================================================
+
+// every program gets its own id, so a frame can tell whose constants it holds
+static std::atomic<uint64_t> programs { 0 };
+
+Program::Program(const Expression& expr, Bindings& bindings) : m_id(++programs) {
+    ProgramCompiler compiler(*this, bindings);
+    compiler.ret(compiler.expression(FlatExpression(expr)));
+    compiler.finish();
+}
+
+Program::Program(const Body& body, Bindings& bindings) : m_id(++programs) {
+    ProgramCompiler compiler(*this, bindings);
+    compiler.statements(body);
+    compiler.finish();
+}
+
+//=============================================================================
+// Public Functions
+//=============================================================================
+
+const std::vector<Program::Instruction>& Program::code() const {
+    return m_code;
+}
+
+uint32_t Program::registers() const {
+    return m_registers;
+}
+
+double Program::run(Environment& env, Frame& frame) const {
+    uint32_t base = static_cast<uint32_t>(m_constants.size());
+    double *environment = env.values();
+
+    // nothing writes to the constants, so they stay loaded for as long as the frame runs this program
+    if (frame.program != m_id) {
+        frame.registers.resize(m_registers);
+        std::copy(m_constants.begin(), m_constants.end(), frame.registers.begin());
+        frame.program = m_id;
+    }
+
+    double *r = frame.registers.data();
+
+    // anything that can fail does so here, the loop itself can't. the other
+    // variables are assigned before they're read
+    for (uint32_t v : m_inputs) {
+        if (!env.assigned(m_variables[v]))
+            throw ParseException("variable does not exist");
+
+        r[base + v] = environment[m_variables[v]];
+    }
+
+    const Instruction *ip = m_code.data();
+    double result;
+
+#ifdef QUASI_COMPUTED_GOTO
+    static const void *const handlers[] = {
+        &&do_MOV, &&do_NEG, &&do_NOT, &&do_ADD, &&do_SUB, &&do_MUL, &&do_DIV, &&do_POW,
+        &&do_EQ, &&do_NE, &&do_LT, &&do_GT, &&do_LE, &&do_GE, &&do_RET, &&do_END,
+    };
+
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == END + 1, "every opcode needs a handler");
+#endif
+
+    DISPATCH_BEGIN
+        HANDLER(MOV): r[ip->dst] = r[ip->a]; DISPATCH();
+        HANDLER(NEG): r[ip->dst] = -r[ip->a]; DISPATCH();
+        HANDLER(NOT): r[ip->dst] = r[ip->a] == 0.0 ? 1.0 : 0.0; DISPATCH();
+        HANDLER(ADD): r[ip->dst] = r[ip->a] + r[ip->b]; DISPATCH();
+        HANDLER(SUB): r[ip->dst] = r[ip->a] - r[ip->b]; DISPATCH();
+        HANDLER(MUL): r[ip->dst] = r[ip->a] * r[ip->b]; DISPATCH();
+        HANDLER(DIV): r[ip->dst] = r[ip->a] / r[ip->b]; DISPATCH();
+        HANDLER(POW): r[ip->dst] = std::pow(r[ip->a], r[ip->b]); DISPATCH();
+        HANDLER(EQ): r[ip->dst] = r[ip->a] == r[ip->b] ? 1.0 : 0.0; DISPATCH();
+        HANDLER(NE): r[ip->dst] = r[ip->a] != r[ip->b] ? 1.0 : 0.0; DISPATCH();
+        HANDLER(LT): r[ip->dst] = r[ip->a] < r[ip->b] ? 1.0 : 0.0; DISPATCH();
+        HANDLER(GT): r[ip->dst] = r[ip->a] > r[ip->b] ? 1.0 : 0.0; DISPATCH();
+        HANDLER(LE): r[ip->dst] = r[ip->a] <= r[ip->b] ? 1.0 : 0.0; DISPATCH();
+        HANDLER(GE): r[ip->dst] = r[ip->a] >= r[ip->b] ? 1.0 : 0.0; DISPATCH();
+        HANDLER(RET): result = r[ip->a]; goto done;
+        HANDLER(END): result = 0.0; goto done;
+    DISPATCH_END
+
+done:
+    for (uint32_t v : m_outputs) {
+        environment[m_variables[v]] = r[base + v];
+        env.mark(m_variables[v]);
+    }
+
+    return result;
+}
+
+double Program::run(Environment& environment) const {
+    Frame frame;
+    return run(environment, frame);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bindings.h"
+
+class Expression;
+class Body;
+
+// an expression or function body compiled for a register machine. every
+// instruction names its destination and operands directly, so constants and
+// variables are never pushed or loaded: the register file holds the constants,
+// then one register per variable, then the temporaries
+class Program {
+public:
+    enum Opcode : uint8_t {
+        MOV,
+        NEG,
+        NOT,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        POW,
+        EQ,
+        NE,
+        LT,
+        GT,
+        LE,
+        GE,
+        RET,    // return register a
+        END,    // fell off the end of a body, return 0
+    };
+
+    struct Instruction {
+        Opcode opcode;
+        uint32_t dst, a, b;
+    };
+
+    // the register file run works in. reusing one for the same program skips
+    // both the allocation and loading the constants again
+    struct Frame {
+        std::vector<double> registers;
+        // the id of the program whose constants are in the registers, 0 for none
+        uint64_t program = 0;
+    };
+
+private:
+    std::vector<Instruction> m_code;
+    std::vector<double> m_constants;
+
+    // the environment slot of the variable in register constants.size() + i
+    std::vector<uint32_t> m_variables;
+    // variables read before the program assigns them, they have to be assigned already when it's run
+    std::vector<uint32_t> m_inputs;
+    // variables the program assigns, they're written back when it returns
+    std::vector<uint32_t> m_outputs;
+
+    uint32_t m_registers = 0;
+    uint64_t m_id;
+
+    friend class ProgramCompiler;
+
+public:
+    // each variable is bound in `bindings` and gets a register after the constants
+    Program(const Expression& expr, Bindings& bindings);
+    // throws a ParseException if any statement couldn't be parsed
+    Program(const Body& body, Bindings& bindings);
+
+    const std::vector<Instruction>& code() const;
+    uint32_t registers() const;
+
+    // copies the inputs from `environment` into their registers, runs, and
+    // copies whatever was assigned back when it returns, so `environment` is
+    // untouched if an input isn't assigned. registers hold exactly the values
+    // the tree walker computes, the result matches Expression::evaluate
+    double run(Environment& environment, Frame& frame) const;
+    double run(Environment& environment) const;
+};
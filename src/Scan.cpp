@@ -0,0 +1,149 @@
+#include "Scan.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QUASI_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+enum class Run { SPACE, COMMENT, IDENT, NUMBER };
+
+template <Run R>
+inline bool in_run(char c) {
+    switch (R) {
+        case Run::SPACE: return c == ' ' || (c >= '\t' && c <= '\r');
+        case Run::COMMENT: return c != '\n';
+        case Run::IDENT: return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        case Run::NUMBER: return (c >= '0' && c <= '9') || c == '.';
+    }
+
+    return false;
+}
+
+//=============================================================================
+// Scalar
+//=============================================================================
+
+template <Run R>
+const char *scalar_skip(const char *p, const char *end) {
+    while (p < end && in_run<R>(*p)) p++;
+    return p;
+}
+
+// skips nothing, the DFA is left to step through the run itself
+const char *no_skip(const char *p, const char *) {
+    return p;
+}
+
+#ifdef QUASI_SCAN_X86
+
+//=============================================================================
+// SSE2, 16 bytes at a time
+//=============================================================================
+
+inline __m128i sse2_between(__m128i x, char lo, char hi) {
+    __m128i clamped = _mm_min_epu8(_mm_max_epu8(x, _mm_set1_epi8(lo)), _mm_set1_epi8(hi));
+    return _mm_cmpeq_epi8(clamped, x);
+}
+
+template <Run R>
+inline __m128i sse2_match(__m128i x) {
+    switch (R) {
+        case Run::SPACE: return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), sse2_between(x, '\t', '\r'));
+        case Run::COMMENT: return _mm_xor_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_set1_epi8(-1));
+        case Run::IDENT: return _mm_or_si128(sse2_between(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z'), sse2_between(x, '0', '9'));
+        case Run::NUMBER: return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('.')), sse2_between(x, '0', '9'));
+    }
+
+    return _mm_setzero_si128();
+}
+
+template <Run R>
+const char *sse2_skip(const char *p, const char *end) {
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned mask = ~_mm_movemask_epi8(sse2_match<R>(x)) & 0xffff;
+
+        if (mask) return p + __builtin_ctz(mask);
+    }
+
+    return scalar_skip<R>(p, end);
+}
+
+//=============================================================================
+// AVX2, 32 bytes at a time
+//=============================================================================
+
+__attribute__((target("avx2")))
+inline __m256i avx2_between(__m256i x, char lo, char hi) {
+    __m256i clamped = _mm256_min_epu8(_mm256_max_epu8(x, _mm256_set1_epi8(lo)), _mm256_set1_epi8(hi));
+    return _mm256_cmpeq_epi8(clamped, x);
+}
+
+template <Run R>
+__attribute__((target("avx2")))
+inline __m256i avx2_match(__m256i x) {
+    switch (R) {
+        case Run::SPACE: return _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), avx2_between(x, '\t', '\r'));
+        case Run::COMMENT: return _mm256_xor_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')), _mm256_set1_epi8(-1));
+        case Run::IDENT: return _mm256_or_si256(avx2_between(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z'), avx2_between(x, '0', '9'));
+        case Run::NUMBER: return _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('.')), avx2_between(x, '0', '9'));
+    }
+
+    return _mm256_setzero_si256();
+}
+
+template <Run R>
+__attribute__((target("avx2")))
+const char *avx2_skip(const char *p, const char *end) {
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(avx2_match<R>(x)));
+
+        if (mask) return p + __builtin_ctz(mask);
+    }
+
+    return sse2_skip<R>(p, end);
+}
+
+#endif
+
+constexpr Scanner none = { no_skip, no_skip, no_skip, no_skip };
+constexpr Scanner scalar = { scalar_skip<Run::SPACE>, scalar_skip<Run::COMMENT>, scalar_skip<Run::IDENT>, scalar_skip<Run::NUMBER> };
+
+#ifdef QUASI_SCAN_X86
+constexpr Scanner sse2 = { sse2_skip<Run::SPACE>, sse2_skip<Run::COMMENT>, sse2_skip<Run::IDENT>, sse2_skip<Run::NUMBER> };
+constexpr Scanner avx2 = { avx2_skip<Run::SPACE>, avx2_skip<Run::COMMENT>, avx2_skip<Run::IDENT>, avx2_skip<Run::NUMBER> };
+#endif
+
+const Scanner *fastest() {
+#ifdef QUASI_SCAN_X86
+    return __builtin_cpu_supports("avx2") ? &avx2 : &sse2;
+#else
+    return &scalar;
+#endif
+}
+
+const Scanner *selected = nullptr;
+
+}
+
+const Scanner& Scanner::get() {
+    static const Scanner *scanner = fastest();
+    return selected ? *selected : *scanner;
+}
+
+bool Scanner::select(const char *name) {
+    if (std::strcmp(name, "none") == 0) selected = &none;
+    else if (std::strcmp(name, "scalar") == 0) selected = &scalar;
+#ifdef QUASI_SCAN_X86
+    else if (std::strcmp(name, "sse2") == 0) selected = &sse2;
+    else if (std::strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) selected = &avx2;
+#endif
+    else return false;
+
+    return true;
+}
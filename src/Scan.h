@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+// fast paths for the long runs of bytes the lexer would otherwise step through
+// one at a time. each function returns the first byte in [p, end) that is not
+// part of the run, or end.
+struct Scanner {
+    // ' ', '\t', '\n', '\v', '\f', '\r'
+    const char *(*skip_space)(const char *p, const char *end);
+    // anything but '\n'
+    const char *(*skip_comment)(const char *p, const char *end);
+    // [A-Za-z0-9]
+    const char *(*skip_ident)(const char *p, const char *end);
+    // [0-9.]
+    const char *(*skip_number)(const char *p, const char *end);
+
+    // the fastest implementation the running cpu supports, picked once
+    static const Scanner& get();
+
+    // use the named implementation from now on instead: "avx2", "sse2", "scalar",
+    // or "none" to send every byte through the lexer's DFA. false if the cpu
+    // can't run it. meant for benchmarks, call it before anything is lexed
+    static bool select(const char *name);
+};
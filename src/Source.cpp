@@ -1,76 +1,95 @@
 #include "Source.h"
+#include "Expression.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <optional>
+#include <thread>
 
 std::ostream& operator<<(std::ostream& os, const Source& src) {
     size_t counter = 0;
 
     for (auto& function : src.functions) {
         os << "#" << counter++ << ": " << "fn " << function.name()
-            << " " << function.return_type() << std::endl;
+            << " " << function.return_type();
+
+        if (function.has_body() && function.ast()) {
+            os << " (" << function.ast()->statements().size() << " statements";
+
+            if (function.ast()->folded())
+                os << ", " << function.ast()->folded() << " nodes folded";
+
+            if (function.ast()->simplified())
+                os << ", " << function.ast()->simplified() << " simplified";
+
+            os << ")";
+        }
+
+        os << std::endl;
     }
 
     return os;
 }
 
-void Source::push(const Function& func) {
+void Source::push(Function func) {
     // ignore macros for now
-    if (func.name() == "") return;
+    if (func.symbol() == NOSYMBOL) return;
 
-    functions.push_back(func);
+    functions.push_back(std::move(func));
 }
 
-static Function parse_function(const std::vector<Lexicon>& lexes) {
+// `lexes` is the prototype, from `fn` up to but not including the `{`, `then` or `;`.
+// nullopt if it is malformed, the reason is reported to `diagnostics`
+static std::optional<Function> parse_function(LexSpan lexes, Diagnostics& diagnostics) {
     // first lexicon should always be fn
-    Lexicon fn = lexes[0];
+    const Lexicon& fn = lexes[0];
+    size_t size = lexes.size();
 
-    auto get_end = [&]() -> size_t {
-        size_t end = 0;
-
-        for (auto& lex : lexes) {
-            if (lex.op() == Op::OSTMT || lex.op() == Op::SEMI || lex.keyword() == Keyword::THEN) break;
-            end++;
-        }
-
-        return end;
-    };
-
-    size_t size = get_end();
-
-    std::string name;
+    Symbol name = NOSYMBOL;
     Type rettype = Type::VOID;
 
     if (fn.keyword() != Keyword::FN) {
-        std::cerr << "no fn keyword found yet attempted to parse a function prototype" << std::endl;
-        abort();
+        diagnostics.error(fn.offset(), "no fn keyword found yet attempted to parse a function prototype");
+        return std::nullopt;
     }
 
     // proc lambda
     if (size == 1) {
-        return FunctionPrototype("");
+        return FunctionPrototype(NOSYMBOL);
     }
 
     if (size == 2) {
         switch (lexes[1].type()) {
             // it's a named proc
-            case Lexicon::Type::IDENTIFIER: return FunctionPrototype(lexes[1].ident());
+            case Lexicon::Type::IDENTIFIER: return FunctionPrototype(lexes[1].symbol());
 
             // it's a lambda function with a return type
-            case Lexicon::Type::TYPE: return FunctionPrototype("", lexes[1].vtype());
+            case Lexicon::Type::TYPE: return FunctionPrototype(NOSYMBOL, lexes[1].vtype());
 
             default:
-                std::cerr << "fn expected a return type or identifier" << std::endl;
-                abort();
+                diagnostics.error(lexes[1].offset(), "fn expected a return type or identifier");
+                return std::nullopt;
         }
     }
 
     if (size == 3) {
         // handle only case of 3 where it's not `fn name type`, `fn ()`
         if (lexes[1].op() == Op::OPAREN && lexes[2].op() == Op::CPAREN) {
-            return FunctionPrototype("");
+            return FunctionPrototype(NOSYMBOL);
         }
 
-        name = lexes[1].ident();
+        if (lexes[1].type() != Lexicon::Type::IDENTIFIER) {
+            diagnostics.error(lexes[1].offset(), "fn expected a function name");
+            return std::nullopt;
+        }
+
+        if (lexes[2].type() != Lexicon::Type::TYPE) {
+            diagnostics.error(lexes[2].offset(), "fn expected a return type");
+            return std::nullopt;
+        }
+
+        name = lexes[1].symbol();
         rettype = lexes[2].vtype();
     }
 
@@ -83,7 +102,7 @@ static Function parse_function(const std::vector<Lexicon>& lexes) {
     
         // function
         else if (lexes[1].type() == Lexicon::Type::IDENTIFIER) {
-            name = lexes[1].ident();
+            name = lexes[1].symbol();
         }
 
         // handle arguments for function
@@ -99,45 +118,130 @@ static Function parse_function(const std::vector<Lexicon>& lexes) {
     return Function(name, rettype);
 }
 
-Source Source::parse(const std::vector<Lexicon>& lexes) {
+LexSpan Source::body(const Function& func) const {
+    return LexSpan(lexes).slice(func.body_begin(), func.body_end());
+}
+
+Source Source::parse(std::vector<Lexicon> tokens, Diagnostics& diagnostics) {
     Source src;
+    src.lexes = std::move(tokens);
+
+    const std::vector<Lexicon>& lexes = src.lexes;
+    LexSpan all(lexes);
 
+    // every token is looked at once: the prototype and body of a function are
+    // found in one forward scan and only handed on as ranges of `lexes`
     for (size_t i = 0; i < lexes.size(); i++) {
-        if (lexes[i].keyword() == Keyword::FN) {
-            Function func = parse_function(std::vector<Lexicon>(lexes.begin() + i, lexes.end()));
+        if (lexes[i].keyword() != Keyword::FN) continue;
 
-            std::vector<Lexicon> body;
+        size_t start = i;
 
-            for (; i < lexes.size(); i++) {
-                if (lexes[i].op() == Op::OSTMT || lexes[i].keyword() == Keyword::THEN || lexes[i].op() == Op::SEMI)
-                    break;
-            }
+        for (; i < lexes.size(); i++) {
+            if (lexes[i].op() == Op::OSTMT || lexes[i].keyword() == Keyword::THEN || lexes[i].op() == Op::SEMI)
+                break;
+        }
 
-            if (lexes[i].op() == Op::OSTMT) {
-                size_t depth = 1;
-                i++;
+        if (i == lexes.size()) {
+            diagnostics.error(lexes[start].offset(), "expected a body or ';' after the function prototype");
+            break;
+        }
+
+        // a broken prototype is reported and its body still skipped, so
+        // parsing picks up again at the next function
+        std::optional<Function> func = parse_function(all.slice(start, i), diagnostics);
+        size_t body_begin = i, body_end = i;
 
-                for (; i < lexes.size(); i++) {
-                    if (lexes[i].op() == Op::OSTMT) depth++;
-                    if (lexes[i].op() == Op::CSTMT) depth--;
+        if (lexes[i].op() == Op::OSTMT) {
+            size_t depth = 1;
+            size_t open = i++;
 
-                    if (depth == 0) break;
+            for (; i < lexes.size(); i++) {
+                if (lexes[i].op() == Op::OSTMT) depth++;
+                if (lexes[i].op() == Op::CSTMT) depth--;
 
-                    body.push_back(lexes[i]);
-                }
-            } else if (lexes[i].keyword() == Keyword::THEN) {
-                i++;
-                for (; i < lexes.size(); i++) {
-                    body.push_back(lexes[i]);
-                    if (lexes[i].op() == Op::SEMI) break;
-                }
+                if (depth == 0) break;
             }
 
-            if (body.size()) func.attach_body(body);
+            if (depth != 0)
+                diagnostics.error(lexes[open].offset(), "expected a '}' to match");
+
+            body_begin = open + 1;
+            body_end = i;
+        } else if (lexes[i].keyword() == Keyword::THEN) {
+            size_t then = ++i;
+
+            for (; i < lexes.size(); i++) {
+                if (lexes[i].op() == Op::SEMI) break;
+            }
 
-            src.push(func);
+            body_begin = then;
+            body_end = std::min(i + 1, lexes.size());
         }
+
+        if (!func) continue;
+
+        func->attach_body(body_begin, body_end);
+
+        src.push(std::move(*func));
+    }
+
+    return src;
+}
+
+void Source::set_fast_math(bool enabled) {
+    fast_math = enabled;
+}
+
+Function *Source::find(Symbol name) {
+    for (auto& function : functions) {
+        if (function.symbol() == name) return &function;
     }
 
+    return nullptr;
+}
+
+const Body& Source::ast(Function& func, Diagnostics& diagnostics) {
+    if (!func.ast())
+        func.attach_ast(Body::parse(body(func), diagnostics, fast_math));
+
+    return *func.ast();
+}
+
+void Source::parse_bodies(Diagnostics& diagnostics, unsigned jobs) {
+    // bodies don't depend on each other, so each worker takes the next
+    // unparsed function until there are none left. every function reports
+    // into its own Diagnostics, which are merged in order afterwards
+    std::vector<Diagnostics> reports(functions.size());
+    std::atomic<size_t> next { 0 };
+
+    auto work = [&]() {
+        for (size_t n; (n = next.fetch_add(1, std::memory_order_relaxed)) < functions.size();) {
+            ast(functions[n], reports[n]);
+        }
+    };
+
+    jobs = static_cast<unsigned>(std::min<size_t>(std::max(jobs, 1u), functions.size()));
+
+    std::vector<std::thread> workers;
+
+    for (unsigned i = 1; i < jobs; i++)
+        workers.emplace_back(work);
+
+    work();
+
+    for (auto& worker : workers)
+        worker.join();
+
+    for (auto& report : reports)
+        diagnostics.append(report);
+}
+
+Source Source::parse(std::vector<Lexicon> lexes) {
+    Diagnostics diagnostics;
+    Source src = parse(std::move(lexes), diagnostics);
+
+    if (diagnostics.has_errors())
+        throw ParseException(diagnostics.all().front().message);
+
     return src;
 }
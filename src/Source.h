@@ -6,12 +6,30 @@
 
 #include "Lexicon.h"
 #include "Function.h"
+#include "Diagnostics.h"
 
 // parse an entire file
 class Source {
+    // every token in the file, functions refer to their bodies by index into this
+    std::vector<Lexicon> lexes;
     std::vector<Function> functions;
+    // let bodies be simplified in ways that can change how results round
+    bool fast_math = false;
 public:
-    void push(const Function& func);
-    static Source parse(const std::vector<Lexicon>& lex);
+    void push(Function func);
+    // the tokens of a function's body
+    LexSpan body(const Function& func) const;
+    // throws a ParseException for the first problem found
+    static Source parse(std::vector<Lexicon> lex);
+    // parses every function it can, problems are reported to `diagnostics`
+    static Source parse(std::vector<Lexicon> lex, Diagnostics& diagnostics);
+    void set_fast_math(bool enabled);
+    // the first function named `name`, or null
+    Function *find(Symbol name);
+    // the parsed body of `func`, which is only parsed the first time it is asked for.
+    // problems found while parsing it are reported to `diagnostics`
+    const Body& ast(Function& func, Diagnostics& diagnostics);
+    // parse every body not yet parsed on up to `jobs` threads, diagnostics come out in function order
+    void parse_bodies(Diagnostics& diagnostics, unsigned jobs = 1);
     friend std::ostream& operator<<(std::ostream& os, const Source& src);
 };
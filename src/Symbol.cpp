@@ -0,0 +1,83 @@
+#include "Symbol.h"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct Interner {
+    std::shared_mutex mutex;
+
+    // deque never moves its elements, so views into these strings stay valid
+    std::deque<std::string> storage;
+    std::vector<std::string_view> names;
+    std::unordered_map<std::string_view, Symbol> ids;
+
+    Interner() {
+        names.push_back(std::string_view());
+        ids.emplace(std::string_view(), NOSYMBOL);
+    }
+};
+
+Interner& interner() {
+    static Interner table;
+    return table;
+}
+
+// look `name` up in the shared table, adding it if needed. returns the
+// table's own copy of the name along with its id
+std::pair<std::string_view, Symbol> intern_shared(std::string_view name) {
+    Interner& table = interner();
+
+    {
+        std::shared_lock lock(table.mutex);
+        auto it = table.ids.find(name);
+
+        if (it != table.ids.end()) return *it;
+    }
+
+    std::unique_lock lock(table.mutex);
+
+    // someone else may have added it between the two locks
+    auto it = table.ids.find(name);
+    if (it != table.ids.end()) return *it;
+
+    Symbol sym = static_cast<Symbol>(table.names.size());
+    std::string_view stored = table.storage.emplace_back(name);
+
+    table.names.push_back(stored);
+    table.ids.emplace(stored, sym);
+
+    return { stored, sym };
+}
+
+}
+
+Symbol SymbolTable::intern(std::string_view name) {
+    // names this thread has already seen, so threads lexing in parallel don't
+    // all contend on the shared lock. the keys view the table's own storage
+    thread_local std::unordered_map<std::string_view, Symbol> cache;
+
+    auto cached = cache.find(name);
+    if (cached != cache.end()) return cached->second;
+
+    return cache.insert(intern_shared(name)).first->second;
+}
+
+std::string_view SymbolTable::name(Symbol sym) {
+    Interner& table = interner();
+    std::shared_lock lock(table.mutex);
+
+    return table.names.at(sym);
+}
+
+size_t SymbolTable::size() {
+    Interner& table = interner();
+    std::shared_lock lock(table.mutex);
+
+    return table.names.size();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// dense id of an interned identifier, equal names always get the same id
+using Symbol = uint32_t;
+
+// the empty name, used for anonymous functions
+constexpr Symbol NOSYMBOL = 0;
+
+// process wide identifier table, safe to use from any number of threads
+class SymbolTable {
+public:
+    // the id for `name`, which is added to the table the first time it is seen
+    static Symbol intern(std::string_view name);
+
+    // the name behind an id, valid for the rest of the program
+    static std::string_view name(Symbol sym);
+
+    static size_t size();
+};
@@ -0,0 +1,269 @@
+#include "TokenCache.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+#include <unordered_map>
+
+#include <unistd.h>
+
+//=============================================================================
+// File format
+//
+//   Header
+//   uint32_t ends[symbols]   end of every name in the name blob
+//   char names[]             the names of every identifier in the file
+//   Lexicon lexes[tokens]    identifiers hold an index into `ends`
+//
+// Tokens are stored exactly as they are in memory, so the format is only
+// meaningful to the build that wrote it. The version mixes the lexer's own
+// fingerprint (tables, reserved words, enums, token size) with `format`, which
+// must be bumped by hand when this layout or the lexer's code changes what it
+// emits for the same tables. Every token is checked on load regardless: a file
+// that doesn't hold tokens lex() could have produced is a miss.
+//=============================================================================
+
+namespace {
+
+constexpr char magic[4] = { 'Q', 'T', 'O', 'K' };
+constexpr uint32_t format = 2;
+
+uint32_t version() {
+    static const uint32_t version = Lexicon::tables_version() * 0x9e3779b1u + format;
+    return version;
+}
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+    uint32_t symbols;
+    uint32_t tokens;
+    uint64_t names;
+};
+
+static_assert(std::is_trivially_copyable<Lexicon>::value, "tokens are written to disk as raw bytes");
+
+inline uint64_t load64(const char *p) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+// the stored value of an enum, read without assuming it is one of the enumerators
+template <class E>
+inline uint32_t stored(const E& e) {
+    static_assert(sizeof(E) == sizeof(uint32_t), "enums in tokens are stored as 32 bits");
+
+    uint32_t value;
+    std::memcpy(&value, &e, sizeof(value));
+    return value;
+}
+
+inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+TokenCache::TokenCache(const std::string& directory) : m_directory(directory) {
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+}
+
+uint64_t TokenCache::hash(std::string_view input) {
+    constexpr uint64_t prime = 0x9e3779b97f4a7c15ull;
+
+    const char *p = input.data(), *end = p + input.size();
+    uint64_t h = input.size() * prime;
+
+    for (; end - p >= 8; p += 8)
+        h = (h ^ mix(load64(p))) * prime;
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, end - p);
+
+    return mix(h ^ tail);
+}
+
+std::string TokenCache::path(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.qtok", static_cast<unsigned long long>(key));
+
+    return m_directory + "/" + name;
+}
+
+std::optional<std::vector<Lexicon>> TokenCache::load(uint64_t key, size_t size) {
+    MappedFile file(path(key));
+    std::string_view data = file.contents();
+    Header header;
+
+    auto miss = [&]() -> std::optional<std::vector<Lexicon>> {
+        m_misses++;
+        return std::nullopt;
+    };
+
+    if (!file.is_open() || data.size() < sizeof(header)) return miss();
+
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version()
+        || header.key != key || header.size != size) return miss();
+
+    // the sizes are bounded by the file before anything is added up, so nothing below can wrap
+    size_t rest = data.size() - sizeof(header);
+
+    if (header.symbols > rest / sizeof(uint32_t) || header.names > rest
+        || header.tokens > rest / sizeof(Lexicon)) return miss();
+
+    size_t ends_at = sizeof(header);
+    size_t names_at = ends_at + header.symbols * sizeof(uint32_t);
+    size_t lexes_at = names_at + header.names;
+
+    if (data.size() != lexes_at + header.tokens * sizeof(Lexicon)) return miss();
+
+    // names are interned once each, then identifiers are pointed at the live ids
+    std::vector<Symbol> symbols(header.symbols);
+    uint32_t begin = 0;
+
+    for (uint32_t i = 0; i < header.symbols; i++) {
+        uint32_t end;
+        std::memcpy(&end, data.data() + ends_at + i * sizeof(end), sizeof(end));
+
+        if (end < begin || end > header.names) return miss();
+
+        symbols[i] = SymbolTable::intern(data.substr(names_at + begin, end - begin));
+        begin = end;
+    }
+
+    std::vector<Lexicon> lexes(header.tokens, Lexicon(Op::NONE));
+    std::memcpy(lexes.data(), data.data() + lexes_at, header.tokens * sizeof(Lexicon));
+
+    // nothing in the file is trusted: every token has to be one the lexer could have made
+    for (auto& lex : lexes) {
+        if (lex.m_offset > size || lex.m_length > size - lex.m_offset) return miss();
+
+        switch (lex.m_type) {
+            case Lexicon::Type::SCALAR:
+            case Lexicon::Type::INTEGER:
+                break;
+            case Lexicon::Type::OPERATOR:
+                if (stored(lex.m_op) == Op::NONE || stored(lex.m_op) > Op::GTE) return miss();
+                break;
+            case Lexicon::Type::KEYWORD:
+                if (stored(lex.m_keyword) == Keyword::NONEKWD || stored(lex.m_keyword) > Keyword::PUB) return miss();
+                break;
+            case Lexicon::Type::TYPE:
+                if (stored(lex.m_vtype) == ::Type::NONETYPE || stored(lex.m_vtype) > ::Type::VOID) return miss();
+                break;
+            case Lexicon::Type::IDENTIFIER:
+                if (lex.m_symbol >= symbols.size()) return miss();
+                lex.m_symbol = symbols[lex.m_symbol];
+                break;
+            default:
+                return miss();
+        }
+    }
+
+    m_hits++;
+    return lexes;
+}
+
+void TokenCache::store(uint64_t key, size_t size, const std::vector<Lexicon>& lexes) {
+    // renumber the identifiers densely from 0, in order of first appearance
+    std::unordered_map<Symbol, uint32_t> local;
+    std::vector<uint32_t> ends;
+    std::string names;
+    std::vector<Lexicon> out(lexes);
+
+    for (auto& lex : out) {
+        // the union is wider than most of its members, the rest must not leak into the file
+        switch (lex.m_type) {
+            case Lexicon::Type::SCALAR:
+            case Lexicon::Type::INTEGER:
+                continue;
+            case Lexicon::Type::OPERATOR: {
+                Op op = lex.m_op;
+                lex.m_integer = 0;
+                lex.m_op = op;
+                continue;
+            }
+            case Lexicon::Type::KEYWORD: {
+                Keyword keyword = lex.m_keyword;
+                lex.m_integer = 0;
+                lex.m_keyword = keyword;
+                continue;
+            }
+            case Lexicon::Type::TYPE: {
+                ::Type type = lex.m_vtype;
+                lex.m_integer = 0;
+                lex.m_vtype = type;
+                continue;
+            }
+            case Lexicon::Type::IDENTIFIER:
+                break;
+        }
+
+        Symbol symbol = lex.m_symbol;
+        lex.m_integer = 0;
+
+        auto [it, added] = local.emplace(symbol, static_cast<uint32_t>(ends.size()));
+
+        if (added) {
+            names += SymbolTable::name(symbol);
+            ends.push_back(static_cast<uint32_t>(names.size()));
+        }
+
+        lex.m_symbol = it->second;
+    }
+
+    Header header {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version();
+    header.key = key;
+    header.size = size;
+    header.symbols = static_cast<uint32_t>(ends.size());
+    header.tokens = static_cast<uint32_t>(out.size());
+    header.names = names.size();
+
+    // the cache is only ever an optimization, failing to write it is not an error
+    std::string final_path = path(key);
+    std::string temp_path = final_path + "." + std::to_string(getpid());
+
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(ends.data()), ends.size() * sizeof(uint32_t));
+        file.write(names.data(), names.size());
+        file.write(reinterpret_cast<const char *>(out.data()), out.size() * sizeof(Lexicon));
+
+        if (!file) {
+            file.close();
+            std::remove(temp_path.c_str());
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, final_path, error);
+
+    if (error) std::remove(temp_path.c_str());
+}
+
+size_t TokenCache::hits() const {
+    return m_hits;
+}
+
+size_t TokenCache::misses() const {
+    return m_misses;
+}
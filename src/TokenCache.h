@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Lexicon.h"
+
+// directory of previously lexed files, keyed by a hash of their contents.
+// entries are written to a temporary file and renamed into place, so any
+// number of compilers can share one directory
+class TokenCache {
+    std::string m_directory;
+    size_t m_hits = 0, m_misses = 0;
+
+    std::string path(uint64_t key) const;
+
+public:
+    TokenCache(const std::string& directory);
+
+    // fast, non cryptographic hash of a file's contents
+    static uint64_t hash(std::string_view input);
+
+    // the tokens stored for a file with this hash and size, if there are any
+    std::optional<std::vector<Lexicon>> load(uint64_t key, size_t size);
+    void store(uint64_t key, size_t size, const std::vector<Lexicon>& lexes);
+
+    size_t hits() const;
+    size_t misses() const;
+};
@@ -3,16 +3,108 @@
 #include <fstream>
 #include <vector>
 #include <unordered_map>
+#include <optional>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Diagnostics.h"
+#include "Expression.h"
 #include "Lexicon.h"
+#include "LineTable.h"
+#include "MappedFile.h"
+#include "Program.h"
 #include "Source.h"
+#include "TokenCache.h"
 #include "cxxopts.hpp"
 
+// print every diagnostic for a file. the file is only read again, and its
+// line table built, once there is something to report
+static void report(const std::string& path, const Diagnostics& diagnostics) {
+    if (diagnostics.empty()) return;
+
+    MappedFile file(path);
+    LineTable lines(file.contents());
+
+    diagnostics.print(std::cerr, path, lines);
+}
+
+// every token in the file at `path`, or nullopt if it can't be read
+static std::optional<std::vector<Lexicon>> tokenize(const std::string& path, unsigned jobs, TokenCache *cache, Diagnostics& diagnostics) {
+    if (jobs <= 1 && cache == nullptr) {
+        // stream it, the file never has to be in memory all at once
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return std::nullopt;
+
+        LexStream stream(fd, diagnostics);
+        std::vector<Lexicon> lexes;
+
+        try {
+            lexes.assign(stream.begin(), stream.end());
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+
+        close(fd);
+        return lexes;
+    }
+
+    // splitting the file up or hashing it needs all of it at once
+    MappedFile file(path);
+    if (!file.is_open()) return std::nullopt;
+
+    uint64_t key = cache ? TokenCache::hash(file.contents()) : 0;
+
+    if (cache) {
+        if (auto lexes = cache->load(key, file.contents().size()))
+            return lexes;
+    }
+
+    std::vector<Lexicon> lexes = Lexicon::lex(file.contents(), diagnostics, jobs);
+
+    // a hit would skip the lexer, and with it the errors, so only clean files are stored
+    if (cache && !diagnostics.has_errors())
+        cache->store(key, file.contents().size(), lexes);
+
+    return lexes;
+}
+
+// compile the body of the function called `name` and run it, printing what it returns.
+// a lazily parsed body is parsed here, reporting to `diagnostics`
+static bool run(Source& src, const std::string& path, const std::string& name, Diagnostics& diagnostics) {
+    Function *func = src.find(SymbolTable::intern(name));
+
+    if (func == nullptr || !func->has_body()) {
+        std::cerr << path << ": no function called " << name << " with a body" << std::endl;
+        return false;
+    }
+
+    try {
+        Bindings bindings;
+        Program program(src.ast(*func, diagnostics), bindings);
+        Environment environment(bindings);
+        double value = program.run(environment);
+
+        std::cout << name << " returned " << value << std::endl;
+    } catch (ParseException& e) {
+        std::cerr << path << ": can't run " << name << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 int main(int argc, const char **argv) {
     cxxopts::Options options("quasi", "a computer language");
 
     options.add_options()
         ("v,verbose", "verbose compiler output", cxxopts::value<bool>()->default_value("false"))
+        ("j,jobs", "number of threads to lex and parse each file with", cxxopts::value<unsigned>()->default_value("1"))
+        ("cache-dir", "reuse the tokens of unchanged files from this directory", cxxopts::value<std::string>())
+        ("lazy", "only parse function bodies once they are used", cxxopts::value<bool>()->default_value("false"))
+        ("fast-math", "allow optimizations that can change how results round", cxxopts::value<bool>()->default_value("false"))
+        ("run", "run the function with this name once the file compiles", cxxopts::value<std::string>())
         ;
     
     options.allow_unrecognised_options();
@@ -25,29 +117,76 @@ int main(int argc, const char **argv) {
         std::cout << "verbose output is enabled" << std::endl;
     }
 
-    for (auto& f : result.unmatched()) {
-        std::ifstream t(f);
-        std::stringstream stream;
-        stream << t.rdbuf();
+    unsigned jobs = result["jobs"].as<unsigned>();
+    bool lazy = result["lazy"].as<bool>();
+    bool fast_math = result["fast-math"].as<bool>();
+    int status = 0;
 
+    std::optional<TokenCache> cache;
+
+    if (result.count("cache-dir"))
+        cache.emplace(result["cache-dir"].as<std::string>());
+
+    for (auto& f : result.unmatched()) {
         if (verbose)
             std::cout << "Compiling " << f << std::endl;
 
         if (verbose)
             std::cout << "tokenizing..." << std::endl;
 
-        std::vector<Lexicon> lexes = Lexicon::lex(stream.str());
+        std::optional<std::vector<Lexicon>> lexes;
+        Diagnostics diagnostics;
+
+        try {
+            lexes = tokenize(f, jobs, cache ? &*cache : nullptr, diagnostics);
+        } catch (LexException& e) {
+            // only things like read errors are still thrown
+            diagnostics.error(e.offset(), e.what());
+            report(f, diagnostics);
+            status = 1;
+            continue;
+        }
+
+        if (!lexes) {
+            std::cerr << "could not open " << f << std::endl;
+            status = 1;
+            continue;
+        }
 
         if (verbose)
             std::cout << "parsing..." << std::endl;
 
-        Source src = Source::parse(lexes);
+        Source src = Source::parse(std::move(*lexes), diagnostics);
+        src.set_fast_math(fast_math);
+        // a verbose dump needs every body, otherwise lazily parsed bodies wait until they're used.
+        // bodies only report statements the expression grammar can't read yet, which
+        // is usually valid code, so that's only worth showing when asked for
+        Diagnostics unsupported;
+
+        if (!lazy || verbose)
+            src.parse_bodies(unsupported, jobs);
+
+        if (verbose)
+            diagnostics.append(unsupported);
+
+        report(f, diagnostics);
+
+        if (diagnostics.has_errors())
+            status = 1;
 
         if (verbose) {
             std::cout << "Functions: " << std::endl;
             std::cout << src << std::endl;
         }
+
+        if (result.count("run") && !diagnostics.has_errors()) {
+            if (!run(src, f, result["run"].as<std::string>(), unsupported))
+                status = 1;
+        }
     }
 
-    return 0;
+    if (verbose && cache)
+        std::cout << "token cache: " << cache->hits() << " hits, " << cache->misses() << " misses" << std::endl;
+
+    return status;
 }
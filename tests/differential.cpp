@@ -0,0 +1,245 @@
+// evaluates random expressions with every evaluator and checks they agree bit for bit:
+// the tree walker by name and by slot, the flat form, the stack machine, the register
+// machine, and the tree walker again after fold() and after fold() and simplify().
+// then runs random function bodies on the register machine against the tree walker
+
+#include "Body.h"
+#include "Expression.h"
+#include "FlatExpression.h"
+#include "Bytecode.h"
+#include "Program.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+static std::mt19937 rng(20261016);
+
+static const char *variables[] = { "x", "y", "z", "w", "u" };
+
+static std::string generate(int depth) {
+    static const char *ops[] = { "+", "-", "*", "/", "**", "==", "!=", "<", ">", "<=", ">=" };
+    // zeros of both signs, a power of two and a divisor whose reciprocal isn't exact are
+    // there for simplify: x + 0, x - -0 and x / 0.1 must not be rewritten, x / 4 may be
+    static const char *atoms[] = { "x", "y", "z", "2", "0.5", "3", "1.25", "7", "0", "w", "u", "-0", "(x * -0)", "4", "0.1" };
+
+    if (depth == 0 || rng() % 4 == 0) return atoms[rng() % (sizeof(atoms) / sizeof(*atoms))];
+
+    switch (rng() % 7) {
+        case 0: return "(" + generate(depth - 1) + ")";
+        case 1: return "-" + generate(depth - 1);
+        case 2: return "!" + generate(depth - 1);
+        // w and u start out unassigned, so reading them first is an error
+        case 3: return std::string("(") + variables[rng() % 5] + " = " + generate(depth - 1) + ")";
+        default: return generate(depth - 1) + " " + ops[rng() % 11] + " " + generate(depth - 1);
+    }
+}
+
+static bool same(double a, double b) {
+    return std::memcmp(&a, &b, sizeof a) == 0;
+}
+
+// x, y and z start out assigned, w and u don't
+static Bindings bindings;
+static std::unordered_map<Symbol, double> initial;
+
+static Environment environment() {
+    Environment env(bindings);
+
+    for (auto& [symbol, value] : initial)
+        env.set(bindings.slot(symbol), value);
+
+    return env;
+}
+
+// whether `env` holds the same variables as `named`
+static bool same(Environment& env, std::unordered_map<Symbol, double>& named) {
+    for (const char *name : variables) {
+        Symbol symbol = SymbolTable::intern(name);
+        uint32_t slot = bindings.slot(symbol);
+        bool assigned = named.count(symbol) != 0;
+
+        if (env.assigned(slot) != assigned || (assigned && !same(env.get(slot), named[symbol]))) return false;
+    }
+
+    return true;
+}
+
+// whether two evaluations by name left the same variables
+static bool same(std::unordered_map<Symbol, double>& a, std::unordered_map<Symbol, double>& b) {
+    for (const char *name : variables) {
+        Symbol symbol = SymbolTable::intern(name);
+        bool assigned = a.count(symbol) != 0;
+
+        if ((b.count(symbol) != 0) != assigned || (assigned && !same(a[symbol], b[symbol]))) return false;
+    }
+
+    return true;
+}
+
+static int check_expressions(int count) {
+    int failures = 0, errors = 0;
+
+    std::vector<double> values;
+    Bytecode::Frame stack_frame;
+    Program::Frame register_frame;
+
+    for (int n = 0; n < count; n++) {
+        // shallow ones too, where a wrong rewrite of a leaf isn't lost in the operators around it
+        std::string src = generate(1 + n % 6);
+        std::vector<Lexicon> lexes = Lexicon::lex(src);
+
+        Arena arena;
+        Expression *expr = Expression::parse(lexes, arena);
+        expr->bind(bindings);
+
+        FlatExpression flat(*expr);
+        Bytecode bytecode(flat, bindings);
+        Program program(*expr, bindings);
+
+        // folding and simplifying rewrite the tree they're given, so each gets a copy of its own
+        Expression *folded = Expression::parse(lexes, arena);
+        folded->fold();
+
+        Expression *simplified = Expression::parse(lexes, arena);
+        simplified->fold();
+        simplified->simplify(arena, false);
+
+        std::unordered_map<Symbol, double> named = initial;
+        std::vector<std::unordered_map<Symbol, double>> maps(3, initial);
+        std::vector<Environment> environments(3, environment());
+
+        constexpr int evaluators = 7;
+        double results[evaluators];
+        bool threw[evaluators] = {};
+
+        auto attempt = [&](int k, auto evaluate) {
+            try {
+                results[k] = evaluate();
+            } catch (ParseException&) {
+                threw[k] = true;
+            }
+        };
+
+        attempt(0, [&] { return expr->evaluate(named); });
+        attempt(1, [&] { return expr->evaluate(environments[0]); });
+        attempt(2, [&] { return flat.evaluate(maps[0], values); });
+        attempt(3, [&] { return bytecode.run(environments[1], stack_frame); });
+        attempt(4, [&] { return program.run(environments[2], register_frame); });
+        attempt(5, [&] { return folded->evaluate(maps[1]); });
+        attempt(6, [&] { return simplified->evaluate(maps[2]); });
+
+        bool ok = true;
+
+        for (int k = 1; k < evaluators; k++)
+            ok = ok && threw[k] == threw[0] && (threw[0] || same(results[k], results[0]));
+
+        // a failed evaluation may stop partway through, only finished ones have to leave the same variables
+        if (ok && !threw[0]) {
+            for (auto& map : maps)
+                ok = ok && same(map, named);
+
+            for (auto& env : environments)
+                ok = ok && same(env, named);
+        }
+
+        if (threw[0]) errors++;
+
+        if (!ok && failures++ < 10)
+            std::cerr << "evaluators disagree on: " << src << std::endl;
+    }
+
+    std::cout << count << " expressions (" << errors << " reading unassigned variables), "
+        << failures << " disagreements" << std::endl;
+
+    return failures;
+}
+
+// bodies of a few statements, often with more after the return, which must never run
+static int check_bodies(int count) {
+    int failures = 0, errors = 0;
+    Program::Frame frame;
+
+    for (int n = 0; n < count; n++) {
+        int statements = 1 + rng() % 5;
+        int returns = rng() % (statements + 1); // no return at all if it's past the end
+
+        std::vector<std::string> expressions;
+        std::string src;
+
+        for (int i = 0; i < statements; i++) {
+            std::string expression = generate(4);
+            const char *keyword = i == returns ? "return " : "";
+
+            if (i != returns && rng() % 2 == 0) {
+                expression = std::string(variables[rng() % 5]) + " = " + expression;
+                keyword = "let ";
+            }
+
+            expressions.push_back(expression);
+            src += keyword + expression + ";\n";
+        }
+
+        // the tree walker, one statement at a time
+        Arena arena;
+        std::unordered_map<Symbol, double> named = initial;
+        double expected = 0.0;
+        bool threw = false;
+
+        try {
+            for (int i = 0; i < statements; i++) {
+                double value = Expression::parse(Lexicon::lex(expressions[i]), arena)->evaluate(named);
+
+                if (i == returns) {
+                    expected = value;
+                    break;
+                }
+            }
+        } catch (ParseException&) {
+            threw = true;
+        }
+
+        Diagnostics diagnostics;
+        Body body = Body::parse(Lexicon::lex(src), diagnostics);
+        Program program(body, bindings);
+        Environment env = environment();
+
+        double result = 0.0;
+        bool program_threw = false;
+
+        try {
+            result = program.run(env, frame);
+        } catch (ParseException&) {
+            program_threw = true;
+        }
+
+        bool ok = !diagnostics.has_errors() && program_threw == threw && (threw || (same(result, expected) && same(env, named)));
+
+        if (threw) errors++;
+
+        if (!ok && failures++ < 10)
+            std::cerr << "register machine disagrees on the body:\n" << src << std::endl;
+    }
+
+    std::cout << count << " bodies (" << errors << " reading unassigned variables), "
+        << failures << " disagreements" << std::endl;
+
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 20000;
+
+    for (int i = 0; i < 5; i++) {
+        Symbol symbol = SymbolTable::intern(variables[i]);
+        bindings.bind(symbol);
+
+        if (i < 3) initial[symbol] = i == 0 ? 1.5 : i == 1 ? -2.0 : 3.0;
+    }
+
+    int failures = check_expressions(count) + check_bodies(count / 4);
+
+    return failures == 0 ? 0 : 1;
+}
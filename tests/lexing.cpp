@@ -0,0 +1,221 @@
+// lexes valid and broken inputs every way there is and checks they all agree
+// with the plain DFA, tokens and problems alike: lex() in one go and on 8
+// threads, with and without diagnostics, and LexStream with chunks of 1 to 97
+// bytes, with every scanner the cpu can run
+
+#include "Lexicon.h"
+#include "Diagnostics.h"
+#include "Scan.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+static std::mt19937 rng(20261016);
+
+static bool same(const Lexicon& a, const Lexicon& b) {
+    if (a.type() != b.type() || a.offset() != b.offset() || a.length() != b.length()) return false;
+
+    switch (a.type()) {
+        case Lexicon::Type::SCALAR: {
+            double x = a.scalar(), y = b.scalar();
+            return std::memcmp(&x, &y, sizeof x) == 0;
+        }
+        case Lexicon::Type::INTEGER: return a.integer() == b.integer();
+        case Lexicon::Type::OPERATOR: return a.op() == b.op();
+        case Lexicon::Type::IDENTIFIER: return a.symbol() == b.symbol();
+        case Lexicon::Type::TYPE: return a.vtype() == b.vtype();
+        case Lexicon::Type::KEYWORD: return a.keyword() == b.keyword();
+    }
+
+    return false;
+}
+
+static bool same(const std::vector<Lexicon>& a, const std::vector<Lexicon>& b) {
+    if (a.size() != b.size()) return false;
+
+    for (size_t i = 0; i < a.size(); i++)
+        if (!same(a[i], b[i])) return false;
+
+    return true;
+}
+
+static bool same(const Diagnostics& a, const Diagnostics& b) {
+    if (a.all().size() != b.all().size()) return false;
+
+    for (size_t i = 0; i < a.all().size(); i++) {
+        auto& d = a.all()[i];
+        auto& e = b.all()[i];
+
+        if (d.severity != e.severity || d.offset != e.offset || std::strcmp(d.message, e.message) != 0) return false;
+    }
+
+    return true;
+}
+
+// what one way of lexing gave: every token and problem, or for the throwing
+// forms the tokens or the first problem
+struct Outcome {
+    std::vector<Lexicon> lexes;
+    Diagnostics diagnostics;
+};
+
+// the throwing forms have to fail on the first problem the reporting forms find, or give their tokens
+static bool same_thrown(const Outcome& expected, const std::vector<Lexicon>& lexes, const LexException *error) {
+    if (expected.diagnostics.empty()) return error == nullptr && same(lexes, expected.lexes);
+    if (error == nullptr) return false;
+
+    auto& first = expected.diagnostics.all().front();
+    return first.offset == error->offset() && std::strcmp(first.message, const_cast<LexException *>(error)->what()) == 0;
+}
+
+static std::string generate(size_t size, bool broken) {
+    static const char *pieces[] = {
+        "fn", "let", "return", "i32", "f64", "x", "value", "a1", "longerName", "12", "3.25", "0",
+        "+", "-", "*", "**", "/", "=", "==", "!=", "<", "<=", "(", ")", "{", "}", ":", ",", ";",
+        " ", "  ", "\t", "\n", "\r\n", "\n\n", "# a comment\n", "#", "18446744073709551615",
+    };
+    // a bad character, a bad identifier, a bad number and one too large for 64 bits
+    static const char *errors[] = { "@", "$", "1a", "1.2.3", "18446744073709551616" };
+
+    std::string text;
+
+    while (text.size() < size) {
+        if (broken && rng() % 40 == 0) text += errors[rng() % (sizeof(errors) / sizeof(*errors))];
+        else text += pieces[rng() % (sizeof(pieces) / sizeof(*pieces))];
+
+        // pieces run together make new tokens, and numbers run together can make bad ones
+        text += broken && rng() % 3 == 0 ? "" : " ";
+    }
+
+    return text;
+}
+
+// every token of a stream over `fd` with chunks of `chunk_size`, throwing on the first problem
+static std::vector<Lexicon> stream(int fd, size_t chunk_size) {
+    lseek(fd, 0, SEEK_SET);
+
+    std::vector<Lexicon> lexes;
+    for (auto& lex : LexStream(fd, chunk_size)) lexes.push_back(lex);
+
+    return lexes;
+}
+
+static std::vector<Lexicon> stream(int fd, Diagnostics& diagnostics, size_t chunk_size) {
+    lseek(fd, 0, SEEK_SET);
+
+    std::vector<Lexicon> lexes;
+    for (auto& lex : LexStream(fd, diagnostics, chunk_size)) lexes.push_back(lex);
+
+    return lexes;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *way, const char *scanner, size_t input, size_t chunk_size = 0) {
+    if (ok || failures++ >= 10) return;
+
+    std::cerr << way << " with the " << scanner << " scanner disagrees on input " << input;
+    if (chunk_size) std::cerr << " in chunks of " << chunk_size;
+    std::cerr << "\n";
+}
+
+int main() {
+    std::vector<std::string> inputs = {
+        "", " ", "\n", "x", "12", "3.25", "**", "#", "# no newline at the end", "let x = 1;",
+        "@", "1a", "1.2.3", "x@", "@x", "a\n@\nb", "18446744073709551616", "1.", ".5", "x\r\n",
+    };
+
+    for (int i = 0; i < 40; i++) inputs.push_back(generate(rng() % 600, i % 2 == 1));
+
+    // several times the size lex() splits at, so 8 threads get a segment each
+    size_t first_large = inputs.size();
+    inputs.push_back(generate(3 << 20, false));
+    inputs.push_back(generate(3 << 20, true));
+
+    // the plain DFA is what every other way has to agree with
+    Scanner::select("none");
+
+    std::vector<Outcome> expected(inputs.size());
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        expected[i].lexes = Lexicon::lex(inputs[i], expected[i].diagnostics);
+
+        if (i == first_large && !expected[i].diagnostics.empty()) {
+            std::cerr << "the large valid input doesn't lex\n";
+            failures++;
+        }
+    }
+
+    const char *scanners[] = { "none", "scalar", "sse2", "avx2" };
+    size_t ways = 0;
+
+    for (const char *scanner : scanners) {
+        if (!Scanner::select(scanner)) {
+            std::cout << "the cpu can't run the " << scanner << " scanner\n";
+            continue;
+        }
+
+        for (size_t i = 0; i < inputs.size(); i++) {
+            const std::string& input = inputs[i];
+
+            for (unsigned jobs : { 1u, 8u }) {
+                Diagnostics diagnostics;
+                std::vector<Lexicon> lexes = Lexicon::lex(input, diagnostics, jobs);
+                check(same(lexes, expected[i].lexes) && same(diagnostics, expected[i].diagnostics),
+                      jobs == 1 ? "lex with diagnostics" : "lex with diagnostics on 8 threads", scanner, i);
+
+                try {
+                    lexes = jobs == 1 ? Lexicon::lex(input) : Lexicon::lex(input, jobs);
+                    check(same_thrown(expected[i], lexes, nullptr), jobs == 1 ? "lex" : "lex on 8 threads", scanner, i);
+                } catch (LexException& error) {
+                    check(same_thrown(expected[i], {}, &error), jobs == 1 ? "lex" : "lex on 8 threads", scanner, i);
+                }
+            }
+
+            std::FILE *file = std::tmpfile();
+            std::fwrite(input.data(), 1, input.size(), file);
+            std::fflush(file);
+
+            // a chunk of every small size is slow on megabytes, the large inputs get a few
+            std::vector<size_t> chunk_sizes = { 4096, 64 * 1024 };
+
+            if (i < first_large) {
+                for (size_t n = 1; n <= 97; n++) chunk_sizes.push_back(n);
+            } else {
+                chunk_sizes.push_back(97);
+            }
+
+            for (size_t chunk_size : chunk_sizes) {
+                Diagnostics diagnostics;
+                std::vector<Lexicon> lexes = stream(fileno(file), diagnostics, chunk_size);
+                check(same(lexes, expected[i].lexes) && same(diagnostics, expected[i].diagnostics),
+                      "LexStream with diagnostics", scanner, i, chunk_size);
+
+                try {
+                    lexes = stream(fileno(file), chunk_size);
+                    check(same_thrown(expected[i], lexes, nullptr), "LexStream", scanner, i, chunk_size);
+                } catch (LexException& error) {
+                    check(same_thrown(expected[i], {}, &error), "LexStream", scanner, i, chunk_size);
+                }
+
+                ways += 2;
+            }
+
+            std::fclose(file);
+            ways += 4;
+        }
+    }
+
+    size_t problems = 0;
+    for (auto& outcome : expected) problems += outcome.diagnostics.all().size();
+
+    std::cout << inputs.size() << " inputs (" << problems << " problems), lexed " << ways
+        << " ways, " << failures << " disagreements\n";
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+// applies random edits to a text and checks that relexing only the edited lines
+// gives the same tokens as lexing the whole text again, then checks that the
+// cost of an edit doesn't grow with the size of the file
+
+#include "Lexicon.h"
+#include "Diagnostics.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+static std::mt19937 rng(20261016);
+
+static bool same(const Lexicon& a, const Lexicon& b) {
+    if (a.type() != b.type() || a.offset() != b.offset() || a.length() != b.length()) return false;
+
+    switch (a.type()) {
+        case Lexicon::Type::SCALAR: {
+            double x = a.scalar(), y = b.scalar();
+            return std::memcmp(&x, &y, sizeof x) == 0;
+        }
+        case Lexicon::Type::INTEGER: return a.integer() == b.integer();
+        case Lexicon::Type::OPERATOR: return a.op() == b.op();
+        case Lexicon::Type::IDENTIFIER: return a.symbol() == b.symbol();
+        case Lexicon::Type::TYPE: return a.vtype() == b.vtype();
+        case Lexicon::Type::KEYWORD: return a.keyword() == b.keyword();
+    }
+
+    return false;
+}
+
+static bool same(const std::vector<Lexicon>& a, const std::vector<Lexicon>& b) {
+    if (a.size() != b.size()) return false;
+
+    for (size_t i = 0; i < a.size(); i++)
+        if (!same(a[i], b[i])) return false;
+
+    return true;
+}
+
+static std::string insertion() {
+    // '@' and "1a" don't lex, so some edits leave the text broken for a while
+    static const char *pieces[] = {
+        "x", "let", " ", "\n", "fn", "i32", "12", "3.5", "+", "=", "==", "*", "**",
+        "(", ")", "{", "}", ";", "# note", "@", "1a", "\n\n", "ab cd", "return",
+    };
+
+    std::string text;
+    for (int n = rng() % 4; n >= 0; n--) text += pieces[rng() % (sizeof(pieces) / sizeof(*pieces))];
+
+    return text;
+}
+
+// random edits to a small text, with and without diagnostics
+static int check_edits(int count) {
+    int failures = 0;
+
+    // long enough to span a few dozen blocks of tokens
+    std::string function = "fn main() i32 {\n    let x = 1;\n    return x + 2;\n}\n", text;
+    for (int i = 0; i < 400; i++) text += function;
+
+    const size_t target = text.size();
+    LexBuffer buffer(text), reported(text);
+
+    for (int n = 0; n < count; n++) {
+        size_t offset = rng() % (text.size() + 1);
+        // mostly typing, with the odd paste or cut of many lines to split and merge blocks
+        size_t removed = rng() % 50 == 0 ? rng() % 2000 : rng() % (text.size() > target ? 12 : 6);
+        removed = std::min(removed, text.size() - offset);
+        std::string inserted = rng() % 3 == 0 ? "" : insertion();
+
+        if (rng() % 50 == 0) {
+            for (int i = rng() % 40; i >= 0; i--) inserted += function;
+        }
+
+        std::string edited = text;
+        edited.replace(offset, removed, inserted);
+        Lexicon::Edit edit { offset, removed, inserted };
+
+        // the diagnostics form never throws and reports what a full lex of the edited lines would
+        Diagnostics full, partial;
+        std::vector<Lexicon> expected = Lexicon::lex(edited, full);
+        reported.relex(edited, edit, partial);
+
+        if (!same(reported.lexes(), expected)) {
+            std::cerr << "relex with diagnostics disagrees with lex after edit " << n << "\n";
+            failures++;
+        }
+
+        // only the edited lines are relexed, so only their problems can be reported
+        for (auto& d : partial.all()) {
+            bool found = false;
+            for (auto& e : full.all()) found |= e.offset == d.offset && std::strcmp(e.message, d.message) == 0;
+
+            if (!found) {
+                std::cerr << "relex reported a problem lex didn't after edit " << n << "\n";
+                failures++;
+            }
+        }
+
+        // the throwing form fails on exactly those problems, and then changes nothing
+        std::vector<Lexicon> before = buffer.lexes();
+
+        try {
+            buffer.relex(edited, edit);
+
+            if (!partial.empty() || !same(buffer.lexes(), expected)) {
+                std::cerr << "relex disagrees with lex after edit " << n << "\n";
+                failures++;
+            }
+        } catch (LexException&) {
+            if (partial.empty() || !same(buffer.lexes(), before)) {
+                std::cerr << "relex failed or changed the tokens after edit " << n << "\n";
+                failures++;
+            }
+
+            // start over from the edited text so later edits stay comparable
+            Diagnostics ignored;
+            buffer = LexBuffer(edited, ignored);
+        }
+
+        for (size_t i = 0; i < expected.size(); i += 7) {
+            if (!same(reported[i], expected[i])) {
+                std::cerr << "token " << i << " is wrong after edit " << n << "\n";
+                failures++;
+                break;
+            }
+        }
+
+        text = edited;
+    }
+
+    return failures;
+}
+
+// average time of an edit near the top of a text of `lines` lines
+static double edit_time(size_t lines) {
+    std::string line = "    let value = first + 2 * second;\n";
+    std::string text, typed;
+
+    for (size_t i = 0; i < lines; i++) text += line;
+
+    // typing a character on line 10 and deleting it again. both texts are built
+    // up front so the timing doesn't include editing the string itself
+    size_t at = 10 * line.size() + 8;
+    typed = text;
+    typed.insert(at, "s");
+
+    LexBuffer buffer(text);
+    constexpr int edits = 2000;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int n = 0; n < edits; n++) {
+        buffer.relex(typed, Lexicon::Edit { at, 0, "s" });
+        buffer.relex(text, Lexicon::Edit { at, 1, "" });
+    }
+
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    double time = elapsed.count() / (2 * edits);
+
+    std::cout << buffer.size() << " tokens: " << time << " us per edit\n";
+    return time;
+}
+
+int main(int argc, char **argv) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 3000;
+    int failures = check_edits(count);
+
+    std::cout << count << " edits, " << failures << " failures\n";
+
+    // a thousand times the tokens should cost about the same per edit. allow
+    // for cache misses and noise, but not for work proportional to the file
+    double small = edit_time(1000), large = edit_time(1000000);
+
+    if (large > 10 * small + 1) {
+        std::cerr << "edits got " << large / small << "x slower on a 1000x larger file\n";
+        failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
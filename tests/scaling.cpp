@@ -0,0 +1,67 @@
+// generates sources of many one line functions and checks that lexing and
+// parsing them takes time linear in the number of functions.
+// `test-scaling --generate N` prints the source for N functions instead
+
+#include "Source.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static std::string generate(size_t functions) {
+    std::string text;
+
+    for (size_t i = 0; i < functions; i++)
+        text += "fn f" + std::to_string(i) + "(x: i32) i32 { return x + " + std::to_string(i) + "; }\n";
+
+    return text;
+}
+
+// best of a few runs of lexing, parsing the file and parsing every body, in ms
+static double parse_time(size_t functions, int& failures) {
+    std::string text = generate(functions);
+    double best = 1e300;
+
+    for (int run = 0; run < 3; run++) {
+        auto start = std::chrono::steady_clock::now();
+
+        Diagnostics diagnostics;
+        Source source = Source::parse(Lexicon::lex(text, diagnostics), diagnostics);
+        source.parse_bodies(diagnostics);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+
+        std::string last = "f" + std::to_string(functions - 1);
+
+        if (diagnostics.has_errors() || source.find(SymbolTable::intern(last)) == nullptr) {
+            std::cerr << "the source of " << functions << " functions didn't parse\n";
+            failures++;
+        }
+    }
+
+    std::cout << functions << " functions: " << best << " ms\n";
+    return best;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2 && std::strcmp(argv[1], "--generate") == 0) {
+        std::cout << generate(std::stoul(argv[2]));
+        return 0;
+    }
+
+    int failures = 0;
+
+    // ten times the functions should take about ten times as long. anything
+    // quadratic is a hundred times slower, so the margin can be generous
+    double small = parse_time(10000, failures), large = parse_time(100000, failures);
+
+    if (large > 20 * small) {
+        std::cerr << "parsing got " << large / small << "x slower for 10x the functions\n";
+        failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}